@@ -0,0 +1,245 @@
+#!/usr/bin/perl
+#	bench.pl
+#	(c) 2020, B D Stephenson
+#	brian@bstephen.me.uk
+#
+#	Runs the benchmark corpus in bench/corpus.txt through sengine, checks
+#	each soundness and key, and compares nodes/sec, total time and peak RSS
+#	against bench/baseline.txt.
+#
+#	perl bench.pl [--update] [--tolerance=pct] [--repeat=n] [engine]
+#
+#	--update rewrites the baseline from this run instead of comparing.
+#	Each problem is run --repeat times and the fastest run is kept, so a
+#	busy machine is less likely to show a false regression.
+
+use warnings;
+use English '-no_match_vars';
+use strict;
+use JSON::PP;
+use Time::HiRes qw(time);
+use IPC::Open3;
+use Symbol 'gensym';
+
+my $CORPUS    = 'bench/corpus.txt';
+my $BASELINE  = 'bench/baseline.txt';
+my $PROG_NAME = 'bench.pl';
+
+our $VERSION = 1.0;
+
+my $update    = 0;
+my $tolerance = 25;
+my $repeat    = 3;
+my $engine    = './sengine143';
+
+foreach my $arg (@ARGV) {
+    if ( $arg eq '--update' ) {
+        $update = 1;
+    }
+    elsif ( $arg =~ m/^--tolerance=(\d+)$/xms ) {
+        $tolerance = $1;
+    }
+    elsif ( $arg =~ m/^--repeat=(\d+)$/xms ) {
+        $repeat = ( $1 > 0 ) ? $1 : 1;
+    }
+    else {
+        $engine = $arg;
+    }
+}
+
+exit main();
+
+sub main {
+    my $r_problems = read_corpus($CORPUS);
+    my $r_base     = $update ? {} : read_baseline($BASELINE);
+    my %results;
+    my $fails = 0;
+
+    printf "%-8s %-15s %12s %9s %9s  %s\n", 'problem', 'soundness',
+      'nodes/sec', 'time(s)', 'rss(kb)', 'verdict';
+
+    foreach my $r_prob ( @{$r_problems} ) {
+        my $r_res = run_problem($r_prob);
+
+        foreach ( 2 .. $repeat ) {
+            my $r_again = run_problem($r_prob);
+            $r_res = $r_again if ( $r_again->{time} < $r_res->{time} );
+        }
+
+        my @why   = check_result( $r_prob, $r_res );
+
+        if ( !$update ) {
+            push @why, compare_baseline( $r_base->{ $r_prob->{name} }, $r_res );
+        }
+
+        $results{ $r_prob->{name} } = $r_res;
+        printf "%-8s %-15s %12.0f %9.3f %9d  %s\n", $r_prob->{name},
+          $r_res->{soundness}, $r_res->{nps}, $r_res->{time},
+          $r_res->{rss}, ( @why ? join q{; }, @why : 'ok' );
+        $fails += scalar @why;
+    }
+
+    if ($update) {
+        write_baseline( $BASELINE, $r_problems, \%results );
+        print "\n$PROG_NAME: baseline written to $BASELINE\n";
+        return 0;
+    }
+
+    print "\n$PROG_NAME: "
+      . ( $fails == 0 ? 'all problems within' : "$fails failure(s) outside" )
+      . " ${tolerance}% of the baseline\n";
+
+    return ( $fails == 0 ) ? 0 : 1;
+}
+
+sub read_corpus {
+    my $file = shift;
+    my @problems;
+
+    open my $fh, '<', $file or die "$PROG_NAME: cannot open $file\n";
+
+    while ( my $line = <$fh> ) {
+        chomp $line;
+        next if ( $line =~ m/^\s*(\#|$)/xms );
+        my ( $name, $kings, $gbr, $pos, $sound, $keys, @opts ) =
+          split /\s+/xms, $line;
+        push @problems,
+          {
+            name  => $name,
+            kings => $kings,
+            gbr   => $gbr,
+            pos   => $pos,
+            sound => $sound,
+            keys  => $keys,
+            opts  => \@opts,
+          };
+    }
+
+    close $fh or die "$PROG_NAME: cannot close $file\n";
+    return \@problems;
+}
+
+sub read_baseline {
+    my $file = shift;
+    my %base;
+
+    open my $fh, '<', $file or die "$PROG_NAME: cannot open $file\n";
+
+    while ( my $line = <$fh> ) {
+        chomp $line;
+        next if ( $line =~ m/^\s*(\#|$)/xms );
+        my ( $name, $nps, $secs, $rss ) = split /\s+/xms, $line;
+        $base{$name} = { nps => $nps, time => $secs, rss => $rss };
+    }
+
+    close $fh or die "$PROG_NAME: cannot close $file\n";
+    return \%base;
+}
+
+sub write_baseline {
+    my ( $file, $r_problems, $r_results ) = @_;
+
+    open my $fh, '>', $file or die "$PROG_NAME: cannot write $file\n";
+    print {$fh} "# problem  nodes/sec  time(s)  rss(kb)  -- written by "
+      . "'perl bench.pl --update'\n";
+
+    foreach my $r_prob ( @{$r_problems} ) {
+        my $r_res = $r_results->{ $r_prob->{name} };
+        printf {$fh} "%-8s %12.0f %9.3f %9d\n", $r_prob->{name},
+          $r_res->{nps}, $r_res->{time}, $r_res->{rss};
+    }
+
+    close $fh or die "$PROG_NAME: cannot close $file\n";
+    return;
+}
+
+sub run_problem {
+    my $r_prob = shift;
+    my @cmd    = (
+        $engine, "--kings=$r_prob->{kings}", "--gbr=$r_prob->{gbr}",
+        "--pos=$r_prob->{pos}", @{ $r_prob->{opts} }, '--stats=json'
+    );
+    my $err = gensym;
+    my $start = time;
+    my $pid = open3( my $in, my $out, $err, @cmd );
+    my $xml = do { local $RS = undef; <$out> };
+    my $json = do { local $RS = undef; <$err> };
+    waitpid $pid, 0;
+    my $secs = time - $start;
+    my $r_stats = eval { decode_json( ( split /\n/xms, $json )[-1] ) } || {};
+    my $nodes = 0;
+
+    foreach my $side (qw(white black)) {
+        foreach my $n ( @{ $r_stats->{nodes}{$side} || [] } ) {
+            $nodes += $n;
+        }
+    }
+
+    my ($sound) = $xml =~ m{<Soundness>([^<]*)</Soundness>}xms;
+
+    return {
+        soundness => $sound || 'FAILED',
+        keys      => join( q{,}, top_level_keys($xml) ),
+        nps       => ( $secs > 0 ) ? $nodes / $secs : 0,
+        time      => $secs,
+        rss       => $r_stats->{rss_kb} || 0,
+    };
+}
+
+sub top_level_keys {
+    my $xml = shift;
+    my @keys;
+    my $depth = 0;
+    my ( undef, $section ) = $xml =~ m{<(Keys|Solutions)>(.*?)</\1>}xms;
+
+    return () if ( !defined $section );
+
+    while ( $section =~ m{<(/?)(wm|bm|thr)>([^<]*)}gxms ) {
+        if ( $1 eq q{/} ) {
+            $depth--;
+        }
+        else {
+            push @keys, $3 if ( $depth == 0 && $2 ne 'thr' );
+            $depth++;
+        }
+    }
+
+    return @keys;
+}
+
+sub check_result {
+    my ( $r_prob, $r_res ) = @_;
+    my @why;
+
+    if ( $r_res->{soundness} ne $r_prob->{sound} ) {
+        push @why, "soundness $r_res->{soundness}, expected $r_prob->{sound}";
+    }
+
+    if ( $r_res->{keys} ne $r_prob->{keys} ) {
+        push @why, "keys $r_res->{keys}, expected $r_prob->{keys}";
+    }
+
+    return @why;
+}
+
+sub compare_baseline {
+    my ( $r_base, $r_res ) = @_;
+    my $slack = $tolerance / 100;
+    my @why;
+
+    return ('no baseline') if ( !defined $r_base );
+
+    if ( $r_res->{nps} < $r_base->{nps} * ( 1 - $slack ) ) {
+        push @why, sprintf 'nodes/sec down from %.0f', $r_base->{nps};
+    }
+
+    if ( $r_res->{time} > $r_base->{time} * ( 1 + $slack ) ) {
+        push @why, sprintf 'time up from %.3f', $r_base->{time};
+    }
+
+    if ( $r_res->{rss} > $r_base->{rss} * ( 1 + $slack ) ) {
+        push @why, "rss up from $r_base->{rss}";
+    }
+
+    return @why;
+}
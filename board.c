@@ -41,20 +41,6 @@ static const char numbers[] = "0123456789";
 static const char squares[] =
     "a1b1c1d1e1f1g1h1a2b2c2d2e2f2g2h2a3b3c3d3e3f3g3h3a4b4c4d4e4f4g4h4a5b5c5d5e5f5g5h5a6b6c6d6e6f6g6h6a7b7c7d7e7f7g7h7a8b8c8d8e8f8g8h8";
 
-#ifdef MOVESTAT
-
-char* toSquare(unsigned char ins)
-{
-    int i = (ins * 2);
-    char* rsq = calloc(1, 3);
-    rsq[0] = squares[i];
-    rsq[1] = squares[i + 1];
-    rsq[2] = '\0';
-    return rsq;
-}
-
-#endif
-
 int tzcount(BITBOARD inBrd)
 {
     if (inBrd == 0) {
@@ -72,13 +58,120 @@ void getKillerHashKey(BOARD* bd, KILLERKEY* kk)
     return;
 }
 
-void getHashKey(BOARD* bd, HASHKEY* hk)
+/*
+ * A symmetry is bit 2 to transpose the board about a1-h8, then bit 0 to
+ * mirror the files and bit 1 to mirror the ranks. Without castling rights
+ * or an ep square a position can be played the same way under all eight
+ * of them, or only under the file mirror (1) if there are pawns.
+ */
+static unsigned char symmetries(BOARD* bd)
+{
+    if (((bd->pos->flags & (W_KING_CASTLING | W_QUEEN_CASTLING | B_KING_CASTLING
+                            | B_QUEEN_CASTLING)) != 0) || (bd->epSquare != 0)) {
+        return 1;
+    }
+
+    if ((bd->pos->bitBoard[WHITE][PAWN] | bd->pos->bitBoard[BLACK][PAWN]) != 0) {
+        return 2;
+    }
+
+    return 8;
+}
+
+static BITBOARD transformBitboard(BITBOARD b, unsigned char sym)
+{
+    BITBOARD t;
+
+    if ((sym & 4) != 0) {
+        t = 0x0f0f0f0f00000000ULL & (b ^ (b << 28));
+        b ^= t ^ (t >> 28);
+        t = 0x3333000033330000ULL & (b ^ (b << 14));
+        b ^= t ^ (t >> 14);
+        t = 0x5500550055005500ULL & (b ^ (b << 7));
+        b ^= t ^ (t >> 7);
+    }
+
+    if ((sym & 1) != 0) {
+        b = ((b >> 1) & 0x5555555555555555ULL) | ((b & 0x5555555555555555ULL) << 1);
+        b = ((b >> 2) & 0x3333333333333333ULL) | ((b & 0x3333333333333333ULL) << 2);
+        b = ((b >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((b & 0x0f0f0f0f0f0f0f0fULL) << 4);
+    }
+
+    if ((sym & 2) != 0) {
+        b = __builtin_bswap64(b);
+    }
+
+    return b;
+}
+
+unsigned char mapSquare(unsigned char sq, unsigned char sym)
+{
+    unsigned char f = FILE(sq);
+    unsigned char r = RANK(sq);
+    unsigned char t;
+
+    if ((sym & 4) != 0) {
+        t = f;
+        f = r;
+        r = t;
+    }
+
+    if ((sym & 1) != 0) {
+        f = 7 - f;
+    }
+
+    if ((sym & 2) != 0) {
+        r = 7 - r;
+    }
+
+    return (unsigned char)((r << 3) | f);
+}
+
+unsigned char symInverse(unsigned char sym)
 {
+    // Undoing a transposition swaps the roles of the two mirrors.
+    if ((sym & 4) != 0) {
+        return (unsigned char)(4 | ((sym & 1) << 1) | ((sym & 2) >> 1));
+    }
+
+    return sym;
+}
+
+/*
+ * The key is taken from the least of the position's symmetric images, and
+ * hk->sym records which symmetry gave it, so a hit stored from a mirrored
+ * position can be mapped onto this one. Results searched under different
+ * rules are told apart by mode.
+ */
+void getHashKey(BOARD* bd, unsigned char mode, HASHKEY* hk)
+{
+    BITBOARD canon[2][7];
+    BITBOARD trial[2][7];
+    unsigned char syms = symmetries(bd);
+    unsigned char sym;
+    int c, p;
     md5_state_t pms;
+    (void) memcpy(canon, bd->pos->bitBoard, sizeof(canon));
+    hk->sym = 0;
+
+    for (sym = 1; sym < syms; sym++) {
+        for (c = 0; c < 2; c++) {
+            for (p = 0; p < 7; p++) {
+                trial[c][p] = transformBitboard(bd->pos->bitBoard[c][p], sym);
+            }
+        }
+
+        if (memcmp(trial, canon, sizeof(canon)) < 0) {
+            (void) memcpy(canon, trial, sizeof(canon));
+            hk->sym = sym;
+        }
+    }
+
     md5_init(&pms);
     md5_append(&pms, & (bd->ply), 1);
+    md5_append(&pms, &mode, 1);
     md5_append(&pms, & (bd->pos->flags), 1);
-    md5_append(&pms, (unsigned char*) & (bd->pos->bitBoard), 112);
+    md5_append(&pms, (unsigned char*) canon, 112);
     md5_finish(&pms, hk->hashkey);
     return;
 }
@@ -90,10 +183,6 @@ bool boardEquals(BOARD* ibd, BOARD* obd)
     assert(ibd != obd);
     assert(ibd->ply == obd->ply);
 
-#ifdef MOVESTAT
-    fprintf(stderr, "%d) boardEquals()\n", ibd->ply);
-#endif
-
     if (obd->mover != ibd->mover) {
         return false;
     }
@@ -127,45 +216,15 @@ bool boardEquals(BOARD* ibd, BOARD* obd)
 
 bool deepEquals(BOARD* ibd, BOARD* obd)
 {
-    BOARDLIST* bl1;
-    BOARDLIST* bl2;
     assert(ibd != NULL);
     assert(obd != NULL);
     assert(ibd->ply == obd->ply);
 
-#ifdef MOVESTAT
-    fprintf(stderr, "%d...deepEquals()\n", ibd->ply);
-#endif
-
     if (boardEquals(ibd, obd) == false) {
         return false;
-    } else {
-        if ((obd->nextply != NULL) && (ibd->nextply != NULL)) {
-            bl1 = obd->nextply;
-            bl2 = ibd->nextply;
-
-            if (bListEquals(bl1, bl2) == false) {
-                return false;
-            }
-        } else if ((obd->nextply == NULL) && (ibd->nextply == NULL)) {
-        } else {
-            return false;
-        }
-
-        if ((obd->threat != NULL) && (ibd->threat != NULL)) {
-            bl1 = obd->threat;
-            bl2 = ibd->threat;
-
-            if (bListEquals(bl1, bl2) == false) {
-                return false;
-            }
-        } else if ((obd->threat == NULL) && (ibd->threat == NULL)) {
-        } else {
-            return false;
-        }
     }
 
-    return true;
+    return (boardFingerprint(ibd) == boardFingerprint(obd));
 }
 
 bool isKey(BOARD* b)
@@ -363,6 +422,7 @@ bool attacks(POSITION* pos, unsigned char square, enum COLOUR colour)
     BITBOARD occupied;
     BBOARD temp;
     int i;
+    stats.attacks_calls++;
 
     // (1) Attack by King?
 
@@ -929,18 +989,25 @@ void generateEP(BOARD* bd, enum COLOUR colour, BOARDLIST* bl)
     return;
 }
 
+static void promote(POSITION* ppos, enum COLOUR colour, int prom, int from,
+                    int to)
+{
+    ppos->bitBoard[colour][PAWN] &= clearMask[from];
+    ppos->bitBoard[colour][OCCUPIED] &= clearMask[from];
+    ppos->bitBoard[colour][prom] |= setMask[to];
+    ppos->bitBoard[colour][OCCUPIED] |= setMask[to];
+    ppos->bitBoard[colour ^ 1][OCCUPIED] &= clearMask[to];
+    ppos->bitBoard[colour ^ 1][PAWN] &= clearMask[to];
+    ppos->bitBoard[colour ^ 1][KNIGHT] &= clearMask[to];
+    ppos->bitBoard[colour ^ 1][BISHOP] &= clearMask[to];
+    ppos->bitBoard[colour ^ 1][ROOK] &= clearMask[to];
+    ppos->bitBoard[colour ^ 1][QUEEN] &= clearMask[to];
+    return;
+}
+
 void makePromotion(BOARD* bd, enum COLOUR colour, int prom, int from, int to)
 {
-    bd->pos->bitBoard[colour][PAWN] &= clearMask[from];
-    bd->pos->bitBoard[colour][OCCUPIED] &= clearMask[from];
-    bd->pos->bitBoard[colour][prom] |= setMask[to];
-    bd->pos->bitBoard[colour][OCCUPIED] |= setMask[to];
-    bd->pos->bitBoard[colour ^ 1][OCCUPIED] &= clearMask[to];
-    bd->pos->bitBoard[colour ^ 1][PAWN] &= clearMask[to];
-    bd->pos->bitBoard[colour ^ 1][KNIGHT] &= clearMask[to];
-    bd->pos->bitBoard[colour ^ 1][BISHOP] &= clearMask[to];
-    bd->pos->bitBoard[colour ^ 1][ROOK] &= clearMask[to];
-    bd->pos->bitBoard[colour ^ 1][QUEEN] &= clearMask[to];
+    promote(bd->pos, colour, prom, from, to);
     return;
 }
 
@@ -1171,6 +1238,7 @@ BOARDLIST* generateWhiteBoardlist(BOARD* inBrd, int ply)
 
     DL_COUNT(wbl->vektor, elt, count);
     wbl->legalMoves = (unsigned char) count;
+    stats.moves_generated += count;
     return wbl;
 }
 
@@ -1180,6 +1248,7 @@ BOARDLIST* generateRefutations(BOARD* brd, int move)
     BOARDLIST* bbl;
     BOARD* elt;
     int count;
+    stats.mate_tests++;
     bbl = getBoardlist(BLACK, (unsigned char) move);
     generateKingMoves(brd, BLACK, bbl);
     DL_COUNT(bbl->vektor, elt, count);
@@ -1355,93 +1424,78 @@ void qualifyMove(BOARDLIST* baseList, BOARD* brd)
     return;
 }
 
-char* toStr(BOARD* bd)
+char* toStr(BOARD* bd, char* ret)
 {
     int f;
-    char tp[5];
-    char* ret;
-    ret = (char*) malloc(16);
-    SENGINE_MEM_ASSERT(ret);
-    ret[0] = numbers[bd->ply];
-    ret[1] = '\0';
+    char* p = ret;
+    const char* q;
+    *p++ = numbers[bd->ply];
 
     if (bd->side == WHITE) {
-        (void) strcat(ret, ".");
+        *p++ = '.';
     } else {
-        (void) strcat(ret, "...");
+        *p++ = '.';
+        *p++ = '.';
+        *p++ = '.';
     }
 
     if (bd->mover == PAWN) {
+        f = bd->to * 2;
+
         if (bd->captured == true) {
-            f = FILE(bd->from);
-            tp[0] = fileArray[f];
-            tp[1] = 'x';
-            f = bd->to * 2;
-            tp[2] = squares[f];
-            tp[3] = squares[f + 1];
-            tp[4] = '\0';
-            (void) strcat(ret, tp);
+            *p++ = fileArray[FILE(bd->from)];
+            *p++ = 'x';
+            *p++ = squares[f];
+            *p++ = squares[f + 1];
 
             if (bd->ep == true) {
-                (void) strcat(ret, " ep");
+                *p++ = ' ';
+                *p++ = 'e';
+                *p++ = 'p';
             }
         } else {
-            f = bd->to * 2;
-            tp[0] = squares[f];
-            tp[1] = squares[f + 1];
-            tp[2] = '\0';
-            (void) strcat(ret, tp);
+            *p++ = squares[f];
+            *p++ = squares[f + 1];
         }
 
         if (bd->promotion != NOPIECE) {
-            tp[0] = pcArray[bd->promotion];
-            tp[1] = '\0';
-            (void) strcat(ret, tp);
+            *p++ = pcArray[bd->promotion];
+        }
+    } else if ((bd->mover == KING) && (bd->from == ((bd->side == WHITE) ? 4 : 60))
+               && ((bd->to == bd->from + 2) || (bd->to == bd->from - 2))) {
+        *p++ = '0';
+        *p++ = '-';
+        *p++ = '0';
+
+        if (bd->to < bd->from) {
+            *p++ = '-';
+            *p++ = '0';
         }
     } else {
-        if ((bd->mover == KING) && (bd->side == WHITE) && (bd->from == 4)
-                && (bd->to == 6)) {
-            (void) strcat(ret, "0-0");
-        } else if ((bd->mover == KING) && (bd->side == WHITE)
-                   && (bd->from == 4) && (bd->to == 2)) {
-            (void) strcat(ret, "0-0-0");
-        } else if ((bd->mover == KING) && (bd->side == BLACK)
-                   && (bd->from == 60) && (bd->to == 62)) {
-            (void) strcat(ret, "0-0");
-        } else if ((bd->mover == KING) && (bd->side == BLACK)
-                   && (bd->from == 60) && (bd->to == 58)) {
-            (void) strcat(ret, "0-0-0");
-        } else {
-            tp[0] = pcArray[bd->mover];
-            tp[1] = '\0';
-            (void) strcat(ret, tp);
+        *p++ = pcArray[bd->mover];
 
-            if (bd->qualifier != '\0') {
-                (void) strcat(ret, bd->qualifier);
-            }
-
-            if (bd->captured == true) {
-                (void) strcat(ret, "x");
-            }
+        for (q = bd->qualifier; *q != '\0'; q++) {
+            *p++ = *q;
+        }
 
-            f = bd->to * 2;
-            tp[0] = squares[f];
-            tp[1] = squares[f + 1];
-            tp[2] = '\0';
-            (void) strcat(ret, tp);
+        if (bd->captured == true) {
+            *p++ = 'x';
         }
+
+        f = bd->to * 2;
+        *p++ = squares[f];
+        *p++ = squares[f + 1];
     }
 
     if ((bd->check == true) && (bd->tag != '#')) {
-        (void) strcat(ret, "+");
+        *p++ = '+';
     }
 
     if (bd->tag != '*') {
-        tp[0] = bd->tag;
-        tp[1] = '\0';
-        (void) strcat(ret, tp);
+        *p++ = bd->tag;
     }
 
+    *p = '\0';
     return ret;
 }
 
@@ -1487,5 +1541,308 @@ BOARDLIST* generateBlackBoardlist(BOARD* bd, int ply, unsigned int* flights)
 
     DL_COUNT(bbl->vektor, elt, count);
     bbl->legalMoves = (unsigned char) count;
+    stats.moves_generated += count;
     return bbl;
 }
+
+/*
+ * The moves of one side walked without building any boards, for the
+ * tests that only need to know what the moves do. Each legal move's
+ * position, and the ep square it leaves, goes to a visitor, and the walk
+ * stops as soon as the visitor returns false.
+ */
+typedef bool (*MOVE_VISIT)(POSITION*, unsigned char, void*);
+
+typedef struct GOAL_WALK {
+    enum COLOUR colour;
+    bool mate;
+    unsigned int moves;
+} GOAL_WALK;
+
+static bool visitLegal(POSITION* npos, enum COLOUR colour, unsigned char ep,
+                       MOVE_VISIT visit, void* ctx)
+{
+    if (attacks(npos, npos->kingsq[colour], (colour ^ 1)) == true) {
+        return true;
+    }
+
+    return (visit)(npos, ep, ctx);
+}
+
+static bool walkPieceMoves(POSITION* pos, enum COLOUR colour, enum PIECE pic,
+                           MOVE_VISIT visit, void* ctx)
+{
+    BITBOARD occupied =
+        pos->bitBoard[WHITE][OCCUPIED] | pos->bitBoard[BLACK][OCCUPIED];
+    BITBOARD ptemp = pos->bitBoard[colour][pic];
+    POSITION npos;
+
+    while (ptemp != 0) {
+        int i = tzcount(ptemp);
+        BITBOARD jtemp;
+        ptemp &= clearMask[i];
+
+        switch (pic) {
+        case KNIGHT:
+            jtemp = knight_attacks[i];
+            break;
+
+        case BISHOP:
+            jtemp = bishop_attacks[i];
+            break;
+
+        case ROOK:
+            jtemp = rook_attacks[i];
+            break;
+
+        default:
+            jtemp = bishop_attacks[i] | rook_attacks[i];
+            break;
+        }
+
+        jtemp &= ~pos->bitBoard[colour][OCCUPIED];
+
+        while (jtemp != 0) {
+            int j = tzcount(jtemp);
+            jtemp &= clearMask[j];
+
+            // A queen's square is on one of its lines, and only that is used.
+            if ((pic != KNIGHT) && ((occupied & ((bishop_commonAttacks[i][j].used == true)
+                                                 ? bishop_commonAttacks[i][j].bb
+                                                 : rook_commonAttacks[i][j].bb)) != 0)) {
+                continue;
+            }
+
+            npos = *pos;
+            nMakeMove(&npos, colour, pic, i, j);
+
+            if (visitLegal(&npos, colour, 0, visit, ctx) == false) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool walkPawnMoves(POSITION* pos, enum COLOUR colour, MOVE_VISIT visit,
+                          void* ctx)
+{
+    BITBOARD occupied =
+        pos->bitBoard[WHITE][OCCUPIED] | pos->bitBoard[BLACK][OCCUPIED];
+    BITBOARD ptemp = pos->bitBoard[colour][PAWN];
+    POSITION npos;
+
+    while (ptemp != 0) {
+        int i = tzcount(ptemp);
+        int last = (colour == WHITE) ? 6 : 1;
+        BITBOARD jtemp = (pawn_attacks[colour][i]
+                          & pos->bitBoard[colour ^ 1][OCCUPIED])
+                         | (pawn_moves[colour][i] & ~occupied);
+        ptemp &= clearMask[i];
+
+        while (jtemp != 0) {
+            int j = tzcount(jtemp);
+            unsigned char ep = 0;
+            jtemp &= clearMask[j];
+
+            if (abs(i - j) == 16) {
+                // A double step needs the square it passes empty.
+                if ((occupied & setMask[(i + j) / 2]) != 0) {
+                    continue;
+                }
+
+                ep = (unsigned char) j;
+            }
+
+            if (RANK(i) == last) {
+                int k;
+
+                for (k = 0; k < 4; k++) {
+                    npos = *pos;
+                    promote(&npos, colour, proms[k], i, j);
+
+                    if (visitLegal(&npos, colour, 0, visit, ctx) == false) {
+                        return false;
+                    }
+                }
+            } else {
+                npos = *pos;
+                nMakeMove(&npos, colour, PAWN, i, j);
+
+                if (visitLegal(&npos, colour, ep, visit, ctx) == false) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool walkMoves(POSITION* pos, unsigned char epSquare, bool check,
+                      enum COLOUR colour, MOVE_VISIT visit, void* ctx)
+{
+    BITBOARD occupied =
+        pos->bitBoard[WHITE][OCCUPIED] | pos->bitBoard[BLACK][OCCUPIED];
+    BITBOARD jtemp;
+    POSITION npos;
+    enum PIECE pic;
+    int from = pos->kingsq[colour];
+    int home = (colour == WHITE) ? 4 : 60;
+    int i;
+
+    // The king first, as a king move is most often what is looked for.
+    jtemp = king_attacks[from] & ~pos->bitBoard[colour][OCCUPIED];
+
+    while (jtemp != 0) {
+        int j = tzcount(jtemp);
+        jtemp &= clearMask[j];
+        npos = *pos;
+        nMakeMove(&npos, colour, KING, from, j);
+        npos.kingsq[colour] = (unsigned char) j;
+
+        if (visitLegal(&npos, colour, 0, visit, ctx) == false) {
+            return false;
+        }
+    }
+
+    for (pic = KNIGHT; pic <= QUEEN; pic++) {
+        if (walkPieceMoves(pos, colour, pic, visit, ctx) == false) {
+            return false;
+        }
+    }
+
+    if (walkPawnMoves(pos, colour, visit, ctx) == false) {
+        return false;
+    }
+
+    // Castling: the king's and rook's squares as in generate*Castlings().
+    if ((check == false) && (from == home)) {
+        unsigned char kflag = (colour == WHITE) ? W_KING_CASTLING : B_KING_CASTLING;
+        unsigned char qflag = (colour == WHITE) ? W_QUEEN_CASTLING : B_QUEEN_CASTLING;
+
+        if (((pos->flags & kflag) != 0)
+                && ((pos->bitBoard[colour][ROOK] & setMask[home + 3]) != 0)
+                && ((occupied & (setMask[home + 1] | setMask[home + 2])) == 0)
+                && (attacks(pos, (unsigned char)(home + 1), (colour ^ 1)) == false)
+                && (attacks(pos, (unsigned char)(home + 2), (colour ^ 1)) == false)) {
+            npos = *pos;
+            nMakeMove(&npos, colour, KING, home, home + 2);
+            nMakeMove(&npos, colour, ROOK, home + 3, home + 1);
+            npos.kingsq[colour] = (unsigned char)(home + 2);
+
+            if ((visit)(&npos, 0, ctx) == false) {
+                return false;
+            }
+        }
+
+        if (((pos->flags & qflag) != 0)
+                && ((pos->bitBoard[colour][ROOK] & setMask[home - 4]) != 0)
+                && ((occupied & (setMask[home - 1] | setMask[home - 2]
+                                 | setMask[home - 3])) == 0)
+                && (attacks(pos, (unsigned char)(home - 1), (colour ^ 1)) == false)
+                && (attacks(pos, (unsigned char)(home - 2), (colour ^ 1)) == false)) {
+            npos = *pos;
+            nMakeMove(&npos, colour, KING, home, home - 2);
+            nMakeMove(&npos, colour, ROOK, home - 4, home - 1);
+            npos.kingsq[colour] = (unsigned char)(home - 2);
+
+            if ((visit)(&npos, 0, ctx) == false) {
+                return false;
+            }
+        }
+    }
+
+    if (epSquare != 0) {
+        int to = (colour == WHITE) ? epSquare + 8 : epSquare - 8;
+
+        for (i = -1; i <= 1; i += 2) {
+            int f = epSquare + i;
+
+            if ((FILE(epSquare) + i < 0) || (FILE(epSquare) + i > 7)
+                    || ((pos->bitBoard[colour][PAWN] & setMask[f]) == 0)) {
+                continue;
+            }
+
+            npos = *pos;
+            npos.bitBoard[colour][PAWN] &= clearMask[f];
+            npos.bitBoard[colour][OCCUPIED] &= clearMask[f];
+            npos.bitBoard[colour][PAWN] |= setMask[to];
+            npos.bitBoard[colour][OCCUPIED] |= setMask[to];
+            npos.bitBoard[colour ^ 1][OCCUPIED] &= clearMask[epSquare];
+            npos.bitBoard[colour ^ 1][PAWN] &= clearMask[epSquare];
+
+            if (visitLegal(&npos, colour, 0, visit, ctx) == false) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool stopAtFirst(POSITION* npos, unsigned char ep, void* ctx)
+{
+    return false;
+}
+
+/*
+ * Whether colour, to play in pos, has any legal move.
+ */
+bool hasLegalMove(POSITION* pos, unsigned char epSquare, bool check,
+                  enum COLOUR colour)
+{
+    return walkMoves(pos, epSquare, check, colour, stopAtFirst, NULL) == false;
+}
+
+static bool visitGoal(POSITION* npos, unsigned char ep, void* ctx)
+{
+    GOAL_WALK* gw = (GOAL_WALK*) ctx;
+    enum COLOUR other = gw->colour ^ 1;
+    bool check = attacks(npos, npos->kingsq[other], gw->colour);
+    gw->moves++;
+
+    if (check != gw->mate) {
+        return false;
+    }
+
+    return hasLegalMove(npos, ep, check, other) == false;
+}
+
+/*
+ * Whether colour, to play from brd, has a move and every move it has
+ * mates the other side, or stalemates it if aim is STALEMATE. A move that
+ * misses ends the walk, so most positions are settled after a move or two.
+ */
+bool forcedGoal(BOARD* brd, enum COLOUR colour, enum AIM aim)
+{
+    GOAL_WALK gw;
+    stats.mate_tests++;
+    gw.colour = colour;
+    gw.mate = (aim == MATE);
+    gw.moves = 0;
+    return (walkMoves(brd->pos, brd->epSquare, brd->check, colour, visitGoal,
+                      &gw) == true) && (gw.moves > 0);
+}
+
+static bool visitMiss(POSITION* npos, unsigned char ep, void* ctx)
+{
+    return visitGoal(npos, ep, ctx) == false;
+}
+
+/*
+ * Whether colour, to play from brd, has a move that mates the other side,
+ * or stalemates it if aim is STALEMATE. The walk ends at the first such
+ * move.
+ */
+bool goalInOne(BOARD* brd, enum COLOUR colour, enum AIM aim)
+{
+    GOAL_WALK gw;
+    stats.mate_tests++;
+    gw.colour = colour;
+    gw.mate = (aim == MATE);
+    gw.moves = 0;
+    return walkMoves(brd->pos, brd->epSquare, brd->check, colour, visitMiss,
+                     &gw) == false;
+}
@@ -42,54 +42,64 @@ static int refutCompare(void* a, void* b)
     }
 }
 
-bool bListEquals(BOARDLIST* ibl, BOARDLIST* obl)
+/*
+ * Fingerprints are Merkle-style: a move's hash covers the fields compared
+ * by boardEquals() and the fingerprints of its continuation and threat
+ * lists, and a list's hash covers its moves in order. They are taken
+ * lazily and kept, so a subtree must be complete when first compared; the
+ * threat walk compares bottom-up, after each subtree is finished.
+ */
+static uint64_t mix(uint64_t h, uint64_t v)
 {
-    int counto, counti;
-    BOARD* tmp;
-    BOARD* tmp1;
-    BOARD* a;
-    BOARD* b;
-    assert(obl != NULL);
-    assert(ibl != NULL);
-    assert(ibl->moveNumber == obl->moveNumber);
-    //assert(obl->vektor != NULL);
-    //assert(ibl->vektor != NULL);
-
-#ifdef MOVESTAT
-    fprintf(stderr, "%d bListEquals()\n", ibl->moveNumber);
-#endif
-
-    DL_COUNT(ibl->vektor, tmp, counti);
-    DL_COUNT(obl->vektor, tmp1, counto);
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
 
-    if (counti != counto) {
-        return false;
-    }
+uint64_t listFingerprint(BOARDLIST* bl)
+{
+    BOARD* b;
+    uint64_t h;
+    assert(bl != NULL);
 
-    if (counti == 0) {
-        return true;
+    if (bl->fingerprint == 0) {
+        h = mix(0, bl->moveNumber);
+        DL_FOREACH(bl->vektor, b) {
+            h = mix(h, boardFingerprint(b));
+        }
+        bl->fingerprint = (h == 0) ? 1 : h;
     }
 
-    /*
-    a = ibl->vektor->next;
-    b = obl->vektor->next;
-    */
-
-    a = ibl->vektor;
-    b = obl->vektor;
-
-    while (a != NULL) {
-        assert(b != NULL);
-
-        if (deepEquals(a, b) == false) {
-            return false;
-        }
+    return bl->fingerprint;
+}
 
-        a = a->next;
-        b = b->next;
+uint64_t boardFingerprint(BOARD* bd)
+{
+    uint64_t h;
+    assert(bd != NULL);
+
+    if (bd->fingerprint == 0) {
+        h = (uint64_t) bd->mover | ((uint64_t) bd->from << 8)
+            | ((uint64_t) bd->to << 16) | ((uint64_t) bd->captured << 24)
+            | ((uint64_t) bd->check << 25) | ((uint64_t) bd->ep << 26)
+            | ((uint64_t)(unsigned char) bd->tag << 32);
+        h = mix(0, h);
+        h = mix(h, (bd->nextply == NULL) ? 0 : listFingerprint(bd->nextply));
+        h = mix(h, (bd->threat == NULL) ? 0 : listFingerprint(bd->threat));
+        bd->fingerprint = (h == 0) ? 1 : h;
     }
 
-    return true;
+    return bd->fingerprint;
+}
+
+bool bListEquals(BOARDLIST* ibl, BOARDLIST* obl)
+{
+    assert(obl != NULL);
+    assert(ibl != NULL);
+    assert(ibl->moveNumber == obl->moveNumber);
+    return (listFingerprint(ibl) == listFingerprint(obl));
 }
 
 void weedOutShortVars(BOARDLIST* ml, unsigned char maxstip)
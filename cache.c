@@ -0,0 +1,399 @@
+/*
+ *	cache.c
+ *	(c) 2020, Brian Stephenson
+ *	brian@bstephen.me.uk
+ *
+ *	A program to test orthodox chess problems of the types:
+ *
+ *		directmates
+ *		selfmates
+ *		relfexmates
+ *		helpmates
+ *
+ *	Input is taken from the program options and output is xml on stdout.
+ *
+ *	This is the module for --cache=DIR, the on-disk store of finished
+ *	results. A problem is keyed by an MD5 of the diagram position, its ep
+ *	square and castling, the stipulation and every option that changes the
+ *	output, and the value is the output exactly as it was written.
+ *
+ *	DIR/index is a fixed open-addressed table of CACHE_SLOTS entries that
+ *	is memory-mapped for lookups; DIR/data holds the values end to end.
+ *	A store appends the value to data and only then fills in its slot,
+ *	writing the key last, all under an exclusive lock on the index, so a
+ *	reader never sees a slot whose value is not complete. A checksum of
+ *	the value guards against anything else.
+ */
+
+#include "sengine.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Raised by every change that alters the output for the same options.
+#define CACHE_VERSION 5
+#define CACHE_SLOTS 65536
+#define CACHE_PROBES 64
+
+extern char* opt_cache;
+extern enum AIM opt_aim;
+extern enum STIP opt_stip;
+extern unsigned int opt_moves;
+extern unsigned int opt_sols;
+extern unsigned int opt_refuts;
+extern bool opt_set;
+extern bool opt_tries;
+extern bool opt_quick;
+extern bool opt_trivialtries;
+extern bool opt_actual;
+extern enum THREATS opt_threats;
+extern bool opt_fleck;
+extern bool opt_shortvars;
+extern bool opt_classify;
+extern bool opt_meson;
+extern bool opt_dag;
+extern enum OUTPUT opt_output;
+
+typedef struct CACHE_HEADER {
+    char magic[8];
+    uint32_t version;
+    uint32_t slots;
+} CACHE_HEADER;
+
+typedef struct CACHE_SLOT {
+    unsigned char key[MD5_LEN];  /* All zero while the slot is free. */
+    uint64_t offset;             /* Of the value in the data file. */
+    uint32_t length;
+    uint32_t check;              /* FNV-1a of the value. */
+} CACHE_SLOT;
+
+static const char cache_magic[8] = "SENCACHE";
+static unsigned char cache_key[MD5_LEN];
+static char* index_path = NULL;
+static char* data_path = NULL;
+static FILE* capture = NULL;
+static int saved_stdout = -1;
+
+static void cacheError(const char* msg, const char* file)
+{
+    (void) fprintf(stderr, "sengine ERROR: %s => %s\n", msg, file);
+    exit(1);
+}
+
+static char* cachePath(const char* name)
+{
+    char* path = (char*) malloc(strlen(opt_cache) + strlen(name) + 2);
+    SENGINE_MEM_ASSERT(path);
+    (void) sprintf(path, "%s/%s", opt_cache, name);
+    return path;
+}
+
+static uint32_t checksum(const unsigned char* p, size_t n)
+{
+    uint32_t h = 0x811c9dc5;
+
+    while (n-- > 0) {
+        h ^= *p++;
+        h *= 0x01000193;
+    }
+
+    return h;
+}
+
+static void addKey(md5_state_t* pms, const void* p, size_t n)
+{
+    md5_append(pms, (const md5_byte_t*) p, (int) n);
+    return;
+}
+
+static void addKeyInt(md5_state_t* pms, unsigned int v)
+{
+    uint32_t u = (uint32_t) v;
+    addKey(pms, &u, sizeof(u));
+    return;
+}
+
+static void makeKey(BOARD* init_pos)
+{
+    md5_state_t pms;
+    md5_init(&pms);
+    addKey(&pms, PROGRAM_VERSION, strlen(PROGRAM_VERSION));
+    addKeyInt(&pms, CACHE_VERSION);
+    addKey(&pms, init_pos->pos->bitBoard, sizeof(init_pos->pos->bitBoard));
+    addKey(&pms, init_pos->pos->kingsq, sizeof(init_pos->pos->kingsq));
+    addKey(&pms, &init_pos->pos->flags, 1);
+    addKey(&pms, &init_pos->epSquare, 1);
+    addKeyInt(&pms, opt_stip);
+    addKeyInt(&pms, opt_aim);
+    addKeyInt(&pms, opt_moves);
+    addKeyInt(&pms, opt_sols);
+    addKeyInt(&pms, opt_refuts);
+    addKeyInt(&pms, opt_threats);
+    addKeyInt(&pms, opt_output);
+    addKeyInt(&pms, (opt_set << 0) | (opt_tries << 1) | (opt_trivialtries << 2)
+              | (opt_actual << 3) | (opt_fleck << 4) | (opt_shortvars << 5)
+              | (opt_classify << 6) | (opt_meson << 7) | (opt_dag << 8)
+              | (opt_quick << 9));
+    md5_finish(&pms, cache_key);
+
+    // An all zero key marks a free slot.
+    cache_key[0] |= 1;
+    return;
+}
+
+/*
+ * Creates the index the first time, through a temporary file linked into
+ * place, so no process ever maps a half-written one.
+ */
+static void createIndex(void)
+{
+    CACHE_HEADER hdr;
+    char* tmp = cachePath("index.XXXXXX");
+    int fd = mkstemp(tmp);
+
+    if (fd < 0) {
+        cacheError("cannot create cache index", tmp);
+    }
+
+    (void) memset(&hdr, 0, sizeof(hdr));
+    (void) memcpy(hdr.magic, cache_magic, sizeof(hdr.magic));
+    hdr.version = CACHE_VERSION;
+    hdr.slots = CACHE_SLOTS;
+
+    if ((fchmod(fd, 0644) != 0) || (write(fd, &hdr, sizeof(hdr)) != (ssize_t) sizeof(hdr))
+            || (ftruncate(fd, sizeof(CACHE_HEADER) + CACHE_SLOTS * sizeof(CACHE_SLOT)) != 0)
+            || (close(fd) != 0)) {
+        cacheError("cannot create cache index", tmp);
+    }
+
+    // Another process may have got there first; its index is as good.
+    if (link(tmp, index_path) != 0) {
+        struct stat st;
+
+        if (stat(index_path, &st) != 0) {
+            cacheError("cannot create cache index", index_path);
+        }
+    }
+
+    (void) unlink(tmp);
+    free(tmp);
+    return;
+}
+
+static CACHE_SLOT* mapIndex(int fd, size_t* len)
+{
+    CACHE_HEADER* hdr;
+    void* map;
+    *len = sizeof(CACHE_HEADER) + CACHE_SLOTS * sizeof(CACHE_SLOT);
+    map = mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (map == MAP_FAILED) {
+        cacheError("cannot map cache index", index_path);
+    }
+
+    hdr = (CACHE_HEADER*) map;
+
+    if ((memcmp(hdr->magic, cache_magic, sizeof(hdr->magic)) != 0)
+            || (hdr->version != CACHE_VERSION) || (hdr->slots != CACHE_SLOTS)) {
+        cacheError("not a cache index for this version", index_path);
+    }
+
+    return (CACHE_SLOT*)(hdr + 1);
+}
+
+static CACHE_SLOT* findSlot(CACHE_SLOT* slots, bool* found)
+{
+    static const unsigned char empty[MD5_LEN];
+    unsigned int i;
+    unsigned int h;
+    (void) memcpy(&h, cache_key, sizeof(h));
+
+    for (i = 0; i < CACHE_PROBES; i++) {
+        CACHE_SLOT* slot = &slots[(h + i) % CACHE_SLOTS];
+
+        if (memcmp(slot->key, cache_key, MD5_LEN) == 0) {
+            *found = true;
+            return slot;
+        }
+
+        if (memcmp(slot->key, empty, MD5_LEN) == 0) {
+            *found = false;
+            return slot;
+        }
+    }
+
+    *found = false;
+    return NULL;
+}
+
+static unsigned char* readValue(CACHE_SLOT* slot)
+{
+    unsigned char* value;
+    int fd = open(data_path, O_RDONLY);
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    value = (unsigned char*) malloc(slot->length + 1);
+    SENGINE_MEM_ASSERT(value);
+
+    if ((pread(fd, value, slot->length, (off_t) slot->offset) != (ssize_t) slot->length)
+            || (checksum(value, slot->length) != slot->check)) {
+        free(value);
+        value = NULL;
+    }
+
+    (void) close(fd);
+    return value;
+}
+
+/*
+ * Looks the problem up and, on a hit, writes the stored output to stdout
+ * and returns true. On a miss, stdout is diverted into a temporary file
+ * until cache_store() is called.
+ */
+bool cache_lookup(BOARD* init_pos)
+{
+    CACHE_SLOT* slots;
+    CACHE_SLOT* slot;
+    size_t len;
+    bool found;
+    unsigned char* value = NULL;
+    uint32_t length = 0;
+    int fd;
+    index_path = cachePath("index");
+    data_path = cachePath("data");
+    makeKey(init_pos);
+
+    if ((mkdir(opt_cache, 0777) != 0) && (errno != EEXIST)) {
+        cacheError("cannot create cache directory", opt_cache);
+    }
+
+    fd = open(index_path, O_RDWR);
+
+    if (fd < 0) {
+        createIndex();
+        fd = open(index_path, O_RDWR);
+
+        if (fd < 0) {
+            cacheError("cannot open cache index", index_path);
+        }
+    }
+
+    slots = mapIndex(fd, &len);
+    slot = findSlot(slots, &found);
+
+    if (found == true) {
+        length = slot->length;
+        value = readValue(slot);
+    }
+
+    (void) munmap((void*)((CACHE_HEADER*) slots - 1), len);
+    (void) close(fd);
+
+    if (value != NULL) {
+        if (fwrite(value, 1, length, stdout) != length) {
+            cacheError("cannot write the cached result", data_path);
+        }
+
+        free(value);
+        free(index_path);
+        free(data_path);
+        return true;
+    }
+
+    (void) fflush(stdout);
+    capture = tmpfile();
+    saved_stdout = dup(STDOUT_FILENO);
+
+    if ((capture == NULL) || (saved_stdout < 0)
+            || (dup2(fileno(capture), STDOUT_FILENO) < 0)) {
+        cacheError("cannot capture the result for", opt_cache);
+    }
+
+    return false;
+}
+
+static void storeValue(const unsigned char* value, size_t length)
+{
+    CACHE_SLOT* slots;
+    CACHE_SLOT* slot;
+    size_t len;
+    bool found;
+    struct stat st;
+    int dfd;
+    int fd = open(index_path, O_RDWR);
+
+    if ((fd < 0) || (flock(fd, LOCK_EX) != 0)) {
+        cacheError("cannot lock cache index", index_path);
+    }
+
+    slots = mapIndex(fd, &len);
+    slot = findSlot(slots, &found);
+
+    // Already stored by a concurrent run, or the probe window is full.
+    if ((found == false) && (slot != NULL)) {
+        dfd = open(data_path, O_RDWR | O_CREAT, 0666);
+
+        if ((dfd < 0) || (fstat(dfd, &st) != 0)
+                || (pwrite(dfd, value, length, st.st_size) != (ssize_t) length)
+                || (fdatasync(dfd) != 0)) {
+            cacheError("cannot write cache data", data_path);
+        }
+
+        (void) close(dfd);
+        slot->offset = (uint64_t) st.st_size;
+        slot->length = (uint32_t) length;
+        slot->check = checksum(value, length);
+        __sync_synchronize();
+        (void) memcpy(slot->key, cache_key, MD5_LEN);
+        (void) msync((void*)((CACHE_HEADER*) slots - 1), len, MS_SYNC);
+    }
+
+    (void) munmap((void*)((CACHE_HEADER*) slots - 1), len);
+    (void) flock(fd, LOCK_UN);
+    (void) close(fd);
+    return;
+}
+
+/*
+ * Puts stdout back, copies the captured output to it and, when the result
+ * is complete, stores it.
+ */
+void cache_store(bool complete)
+{
+    unsigned char* value;
+    long length;
+    (void) fflush(stdout);
+
+    if ((dup2(saved_stdout, STDOUT_FILENO) < 0) || (fseek(capture, 0, SEEK_END) != 0)
+            || ((length = ftell(capture)) < 0)) {
+        cacheError("cannot capture the result for", opt_cache);
+    }
+
+    (void) close(saved_stdout);
+    value = (unsigned char*) malloc((size_t) length + 1);
+    SENGINE_MEM_ASSERT(value);
+    rewind(capture);
+
+    if ((fread(value, 1, (size_t) length, capture) != (size_t) length)
+            || (fwrite(value, 1, (size_t) length, stdout) != (size_t) length)) {
+        cacheError("cannot capture the result for", opt_cache);
+    }
+
+    (void) fflush(stdout);
+    (void) fclose(capture);
+
+    if ((complete == true) && (length > 0) && (length <= UINT32_MAX)) {
+        storeValue(value, (size_t) length);
+    }
+
+    free(value);
+    free(index_path);
+    free(data_path);
+    return;
+}
@@ -0,0 +1,653 @@
+/*
+ *	checkpoint.c
+ *	(c) 2020, Brian Stephenson
+ *	brian@bstephen.me.uk
+ *
+ *	A program to test orthodox chess problems of the types:
+ *
+ *		directmates
+ *		selfmates
+ *		relfexmates
+ *		helpmates
+ *
+ *	Input is taken from the program options and output is xml on stdout.
+ *
+ *	This is the module that writes and reads the checkpoint file used to
+ *	resume long directmate searches. Each completed first move is written
+ *	as one line holding the transposition table entries its search stored,
+ *	the killer table after it and its result tree; a line is only trusted
+ *	once its newline has been written. Resuming replays the entries and the
+ *	killers, so the rest of the search, the threats and the set play see
+ *	the tables, and the lists shared through them, of an unbroken run.
+ *
+ *	A list that is a table entry's is written as R and the entry's key
+ *	wherever it appears after the entry.
+ */
+
+#include "sengine.h"
+#include <unistd.h>
+
+#define CHECKPOINT_VERSION 2
+
+extern char* opt_kings;
+extern char* opt_gbr;
+extern char* opt_pos;
+extern char* opt_castling;
+extern char* opt_ep;
+extern enum AIM opt_aim;
+extern enum STIP opt_stip;
+extern unsigned int opt_moves;
+extern unsigned int opt_refuts;
+extern bool opt_shortvars;
+extern char* opt_checkpoint;
+extern char* opt_resume;
+extern char* opt_merge;
+
+typedef struct CHECKPOINT_ENTRY {
+    int key;
+    char* line;
+    UT_hash_handle hh;
+} CHECKPOINT_ENTRY;
+
+typedef struct CHECKPOINT_LIST {
+    BOARDLIST* list;
+    unsigned char hashkey[MD5_LEN];
+    UT_hash_handle hh;
+} CHECKPOINT_LIST;
+
+static FILE* cpfile = NULL;
+static bool copy_resumed = false;
+static CHECKPOINT_ENTRY* resumed = NULL;
+static const char* source = NULL;
+static CHECKPOINT_LIST* entry_lists = NULL;
+static UT_string* stored = NULL;
+static HASHVALUE** table = NULL;
+
+static int moveKey(BOARD* b)
+{
+    return (int) b->from | ((int) b->to << 8) | ((int) b->promotion << 16);
+}
+
+static void checkpointError(const char* msg, const char* file)
+{
+    (void) fprintf(stderr, "sengine ERROR: %s => %s\n", msg, file);
+    exit(1);
+}
+
+static char* getHeader(void)
+{
+    static char header[256];
+    (void) snprintf(header, sizeof(header),
+                    "sengine-checkpoint %d %s %s %s %s %s %d %d %u %u %d\n",
+                    CHECKPOINT_VERSION, opt_kings, opt_gbr, opt_pos,
+                    (opt_castling == NULL) ? "-" : opt_castling,
+                    (opt_ep == NULL) ? "-" : opt_ep, (int) opt_aim,
+                    (int) opt_stip, opt_moves, opt_refuts, (int) opt_shortvars);
+    return header;
+}
+
+static long readNumber(char** cur)
+{
+    char* end;
+    long n = strtol(*cur, &end, 10);
+
+    if (end == *cur) {
+        checkpointError("corrupt checkpoint file", source);
+    }
+
+    *cur = end;
+    return n;
+}
+
+static BITBOARD readBitboard(char** cur)
+{
+    char* end;
+    BITBOARD bb = (BITBOARD) strtoull(*cur, &end, 16);
+
+    if (end == *cur) {
+        checkpointError("corrupt checkpoint file", source);
+    }
+
+    *cur = end;
+    return bb;
+}
+
+static char readTag(char** cur)
+{
+    while (**cur == ' ') {
+        (*cur)++;
+    }
+
+    if (**cur == '\0') {
+        checkpointError("corrupt checkpoint file", source);
+    }
+
+    return *(*cur)++;
+}
+
+static void readQualifier(char** cur, char* qualifier)
+{
+    int i = 0;
+    char c = readTag(cur);
+
+    if (c != '-') {
+        while ((c != ' ') && (c != '\n') && (c != '\0') && (i < 2)) {
+            qualifier[i++] = c;
+            c = *(*cur)++;
+        }
+
+        (*cur)--;
+    }
+
+    qualifier[i] = '\0';
+    return;
+}
+
+static void loadCheckpoint(const char* file, off_t* valid_end)
+{
+    FILE* fp;
+    char* line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    off_t offset = 0;
+    *valid_end = 0;
+    source = file;
+    fp = fopen(file, "r");
+
+    if (fp == NULL) {
+        checkpointError("cannot open checkpoint file", file);
+    }
+
+    len = getline(&line, &cap, fp);
+
+    if ((len <= 0) || (strcmp(line, getHeader()) != 0)) {
+        checkpointError("checkpoint file does not match this problem", file);
+    }
+
+    offset = (off_t) len;
+    *valid_end = offset;
+
+    while ((len = getline(&line, &cap, fp)) > 0) {
+        CHECKPOINT_ENTRY* ce;
+        char* cur = line;
+        int key;
+
+        if (line[len - 1] != '\n') {
+            // Cut short when the run was stopped
+            break;
+        }
+
+        key = (int) readNumber(&cur);
+        key |= (int) readNumber(&cur) << 8;
+        key |= (int) readNumber(&cur) << 16;
+        HASH_FIND_INT(resumed, &key, ce);
+
+        if (ce == NULL) {
+            ce = (CHECKPOINT_ENTRY*) malloc(sizeof(CHECKPOINT_ENTRY));
+            SENGINE_MEM_ASSERT(ce);
+            ce->key = key;
+            ce->line = strdup(line);
+            SENGINE_MEM_ASSERT(ce->line);
+            HASH_ADD_INT(resumed, key, ce);
+        }
+
+        offset += (off_t) len;
+        *valid_end = offset;
+    }
+
+    free(line);
+    (void) fclose(fp);
+    return;
+}
+
+void open_checkpoint(void)
+{
+    off_t valid_end;
+
+    if (opt_merge != NULL) {
+        // Shards cover disjoint first moves, so their lines just add up.
+        char* files = strdup(opt_merge);
+        char* file;
+        SENGINE_MEM_ASSERT(files);
+
+        for (file = strtok(files, ","); file != NULL; file = strtok(NULL, ",")) {
+            loadCheckpoint(file, &valid_end);
+        }
+
+        source = opt_merge;
+        free(files);
+        copy_resumed = true;
+    } else if (opt_resume != NULL) {
+        loadCheckpoint(opt_resume, &valid_end);
+
+        if ((opt_checkpoint == NULL) || (strcmp(opt_checkpoint, opt_resume) == 0)) {
+            // Carry on appending to the file being resumed.
+            if (truncate(opt_resume, valid_end) != 0) {
+                checkpointError("cannot write checkpoint file", opt_resume);
+            }
+
+            cpfile = fopen(opt_resume, "a");
+
+            if (cpfile == NULL) {
+                checkpointError("cannot write checkpoint file", opt_resume);
+            }
+
+            return;
+        }
+
+        copy_resumed = true;
+    }
+
+    if (opt_checkpoint != NULL) {
+        cpfile = fopen(opt_checkpoint, "w");
+
+        if (cpfile == NULL) {
+            checkpointError("cannot write checkpoint file", opt_checkpoint);
+        }
+
+        (void) fputs(getHeader(), cpfile);
+        (void) fflush(cpfile);
+    }
+
+    return;
+}
+
+static void forgetLists(void)
+{
+    CHECKPOINT_LIST* cl;
+    CHECKPOINT_LIST* tmp;
+    HASH_ITER(hh, entry_lists, cl, tmp) {
+        HASH_DEL(entry_lists, cl);
+        free(cl);
+    }
+    return;
+}
+
+void close_checkpoint(void)
+{
+    CHECKPOINT_ENTRY* ce;
+    CHECKPOINT_ENTRY* tmp;
+
+    if (cpfile != NULL) {
+        (void) fclose(cpfile);
+        cpfile = NULL;
+    }
+
+    HASH_ITER(hh, resumed, ce, tmp) {
+        HASH_DEL(resumed, ce);
+        free(ce->line);
+        free(ce);
+    }
+
+    forgetLists();
+
+    if (stored != NULL) {
+        utstring_free(stored);
+        stored = NULL;
+    }
+
+    table = NULL;
+    return;
+}
+
+static void rememberList(BOARDLIST* bl, unsigned char* hashkey)
+{
+    CHECKPOINT_LIST* cl = (CHECKPOINT_LIST*) malloc(sizeof(CHECKPOINT_LIST));
+    SENGINE_MEM_ASSERT(cl);
+    cl->list = bl;
+    (void) memcpy((void*) cl->hashkey, (void*) hashkey, MD5_LEN);
+    HASH_ADD_PTR(entry_lists, list, cl);
+    return;
+}
+
+static void saveList(UT_string* s, BOARDLIST* bl)
+{
+    BOARD* b;
+    int ct;
+    int i;
+    DL_COUNT(bl->vektor, b, ct);
+    utstring_printf(s, " L %d %d %d %d %d %d %d %d", (int) bl->toPlay,
+                    (int) bl->moveNumber, (int) bl->legalMoves, (int) bl->isTry,
+                    (int) bl->minStip, (int) bl->maxStip, (int) bl->stipIn, ct);
+    DL_FOREACH(bl->vektor, b) {
+        CHECKPOINT_LIST* cl = NULL;
+        utstring_printf(s, " %d %d %d %d %d %d %s", (int) b->from, (int) b->to,
+                        (int) b->promotion, (int) b->tag, (int) b->flights,
+                        (int) b->killer, (b->qualifier[0] == '\0') ? "-" : b->qualifier);
+
+        if (b->nextply != NULL) {
+            HASH_FIND_PTR(entry_lists, &b->nextply, cl);
+        }
+
+        if (cl != NULL) {
+            utstring_printf(s, " R ");
+
+            for (i = 0; i < MD5_LEN; i++) {
+                utstring_printf(s, "%02x", cl->hashkey[i]);
+            }
+        } else if (b->nextply != NULL) {
+            saveList(s, b->nextply);
+        } else {
+            utstring_printf(s, " N");
+        }
+    }
+    return;
+}
+
+/*
+ * Notes a transposition table entry stored for m while a first move is
+ * searched, to go out with that move's line.
+ */
+void checkpointEntry(BOARD* m, HASHKEY* kp, BOARDLIST* cont)
+{
+    int c;
+    int p;
+
+    if (cpfile == NULL) {
+        return;
+    }
+
+    if (stored == NULL) {
+        utstring_new(stored);
+    }
+
+    utstring_printf(stored, " E %d %d %d %d %d %d", (int) m->ply, (int) m->check,
+                    (int) m->epSquare, (int) m->pos->flags, (int) m->pos->kingsq[WHITE],
+                    (int) m->pos->kingsq[BLACK]);
+
+    for (c = 0; c < 2; c++) {
+        for (p = 0; p < 7; p++) {
+            utstring_printf(stored, " %" PRIx64, m->pos->bitBoard[c][p]);
+        }
+    }
+
+    if (cont == NULL) {
+        utstring_printf(stored, " N");
+    } else {
+        saveList(stored, cont);
+        rememberList(cont, kp->hashkey);
+    }
+
+    return;
+}
+
+/*
+ * The table has been emptied under --memory, so its lists may be gone and
+ * are written out in full from now on.
+ */
+void checkpointEvicted(void)
+{
+    forgetLists();
+    return;
+}
+
+void checkpointFirstMove(BOARD* b, BOARDLIST* bml, KILLERHASHVALUE* killers)
+{
+    UT_string* line;
+    KILLERHASHVALUE* khv;
+    KILLERHASHVALUE* tmp;
+
+    if (cpfile != NULL) {
+        utstring_new(line);
+        utstring_printf(line, "%d %d %d", (int) b->from, (int) b->to,
+                        (int) b->promotion);
+
+        if (stored != NULL) {
+            utstring_concat(line, stored);
+            utstring_clear(stored);
+        }
+
+        // In table order, which decides between killers of equal count.
+        utstring_printf(line, " K %u", HASH_COUNT(killers));
+        HASH_ITER(hh, killers, khv, tmp) {
+            utstring_printf(line, " %d %d %d %d", (int) khv->kkey[0], (int) khv->kkey[1],
+                            (int) khv->kkey[2], khv->count);
+        }
+
+        if (bml->stipIn == NOSTIP) {
+            // Refuted outright; its tree is never output.
+            utstring_printf(line, " X");
+        } else {
+            saveList(line, bml);
+        }
+
+        utstring_printf(line, "\n");
+
+        if (fwrite(utstring_body(line), 1, utstring_len(line), cpfile) != utstring_len(line)) {
+            checkpointError("cannot write checkpoint file", opt_checkpoint);
+        }
+
+        (void) fflush(cpfile);
+        utstring_free(line);
+    }
+
+    return;
+}
+
+static BOARDLIST* tableList(char** cur)
+{
+    unsigned char hashkey[MD5_LEN];
+    HASHVALUE* hv;
+    int i;
+
+    while (**cur == ' ') {
+        (*cur)++;
+    }
+
+    for (i = 0; i < MD5_LEN; i++) {
+        unsigned int byte;
+
+        if (sscanf(*cur, "%2x", &byte) != 1) {
+            checkpointError("corrupt checkpoint file", source);
+        }
+
+        hashkey[i] = (unsigned char) byte;
+        *cur += 2;
+    }
+
+    HASH_FIND(hh, *table, hashkey, MD5_LEN, hv);
+
+    if ((hv == NULL) || (hv->cont == NULL)) {
+        checkpointError("corrupt checkpoint file", source);
+    }
+
+    hv->cont->use_count++;
+    return hv->cont;
+}
+
+static BOARDLIST* restoreList(BOARD* parent, char** cur)
+{
+    BOARDLIST* gen;
+    BOARDLIST* bl;
+    BOARD* b;
+    unsigned int flights;
+    enum COLOUR toPlay;
+    unsigned char moveNumber;
+    int ct;
+
+    if (readTag(cur) != 'L') {
+        checkpointError("corrupt checkpoint file", source);
+    }
+
+    toPlay = (enum COLOUR) readNumber(cur);
+    moveNumber = (unsigned char) readNumber(cur);
+    gen = (toPlay == WHITE) ? generateWhiteBoardlist(parent, moveNumber)
+          : generateBlackBoardlist(parent, moveNumber, &flights);
+    bl = getBoardlist(toPlay, moveNumber);
+    bl->legalMoves = (unsigned char) readNumber(cur);
+    bl->isTry = (readNumber(cur) != 0);
+    bl->minStip = (unsigned char) readNumber(cur);
+    bl->maxStip = (unsigned char) readNumber(cur);
+    bl->stipIn = (unsigned char) readNumber(cur);
+    ct = (int) readNumber(cur);
+
+    while (ct-- > 0) {
+        unsigned char from = (unsigned char) readNumber(cur);
+        unsigned char to = (unsigned char) readNumber(cur);
+        enum PIECE promotion = (enum PIECE) readNumber(cur);
+
+        DL_FOREACH(gen->vektor, b) {
+            if ((b->from == from) && (b->to == to) && (b->promotion == promotion)) {
+                break;
+            }
+        }
+
+        if (b == NULL) {
+            checkpointError("checkpoint move is not legal here", source);
+        }
+
+        DL_DELETE(gen->vektor, b);
+        b->tag = (char) readNumber(cur);
+        b->flights = (unsigned char) readNumber(cur);
+        b->killer = (readNumber(cur) != 0);
+        readQualifier(cur, b->qualifier);
+        DL_APPEND(bl->vektor, b);
+
+        while (**cur == ' ') {
+            (*cur)++;
+        }
+
+        if (**cur == 'N') {
+            (*cur)++;
+        } else if (**cur == 'R') {
+            (*cur)++;
+            b->nextply = tableList(cur);
+        } else {
+            b->nextply = restoreList(b, cur);
+        }
+
+        dropRestoredPosition(b);
+    }
+
+    freeBoardlist(gen);
+    return bl;
+}
+
+static void restoreEntry(char** cur)
+{
+    POSITION pos;
+    BOARD* m;
+    BOARDLIST* cont = NULL;
+    HASHKEY kp;
+    HASHVALUE* hv;
+    unsigned char ply;
+    bool check;
+    unsigned char epSquare;
+    int c;
+    int p;
+    ply = (unsigned char) readNumber(cur);
+    check = (readNumber(cur) != 0);
+    epSquare = (unsigned char) readNumber(cur);
+    pos.flags = (unsigned char) readNumber(cur);
+    pos.kingsq[WHITE] = (unsigned char) readNumber(cur);
+    pos.kingsq[BLACK] = (unsigned char) readNumber(cur);
+
+    for (c = 0; c < 2; c++) {
+        for (p = 0; p < 7; p++) {
+            pos.bitBoard[c][p] = readBitboard(cur);
+        }
+    }
+
+    m = getBoard(&pos, BLACK, ply);
+    m->check = check;
+    m->epSquare = epSquare;
+    getHashKey(m, 0, &kp);
+
+    if (readTag(cur) != 'N') {
+        (*cur)--;
+        cont = restoreList(m, cur);
+    }
+
+    freeBoard(m);
+    HASH_FIND(hh, *table, kp.hashkey, MD5_LEN, hv);
+
+    if (hv != NULL) {
+        // Stored again after --memory emptied the table, or by another
+        // shard; the first serves.
+        if (cont != NULL) {
+            freeBoardlist(cont);
+        }
+
+        return;
+    }
+
+    hv = getHashValue();
+    hv->sym = kp.sym;
+    hv->cont = cont;
+    (void) memcpy((void*) hv->hashkey, (void*) kp.hashkey, MD5_LEN);
+    HASH_ADD(hh, *table, hashkey, MD5_LEN, hv);
+
+    if (cont != NULL) {
+        rememberList(cont, kp.hashkey);
+    }
+
+    return;
+}
+
+static void restoreKillers(char** cur, KILLERHASHVALUE** killers)
+{
+    KILLERHASHVALUE* khv;
+    KILLERHASHVALUE* tmp;
+    int ct;
+    HASH_ITER(hh, *killers, khv, tmp) {
+        HASH_DEL(*killers, khv);
+        free(khv);
+    }
+    ct = (int) readNumber(cur);
+
+    while (ct-- > 0) {
+        khv = getKillerHashValue();
+        khv->kkey[0] = (unsigned char) readNumber(cur);
+        khv->kkey[1] = (unsigned char) readNumber(cur);
+        khv->kkey[2] = (unsigned char) readNumber(cur);
+        khv->count = (int) readNumber(cur);
+        HASH_ADD(hh, *killers, kkey, KILLERKEY_LEN, khv);
+    }
+
+    return;
+}
+
+bool resumeFirstMove(BOARD* b, BOARDLIST** bml, HASHVALUE** transtable,
+                     KILLERHASHVALUE** killers)
+{
+    CHECKPOINT_ENTRY* ce;
+    int key = moveKey(b);
+    char* cur;
+    char tag;
+    HASH_FIND_INT(resumed, &key, ce);
+
+    if (ce == NULL) {
+        return false;
+    }
+
+    if ((copy_resumed == true) && (cpfile != NULL)) {
+        (void) fputs(ce->line, cpfile);
+        (void) fflush(cpfile);
+    }
+
+    table = transtable;
+    cur = ce->line;
+    (void) readNumber(&cur);
+    (void) readNumber(&cur);
+    (void) readNumber(&cur);
+
+    while ((tag = readTag(&cur)) == 'E') {
+        restoreEntry(&cur);
+    }
+
+    if (tag != 'K') {
+        checkpointError("corrupt checkpoint file", source);
+    }
+
+    restoreKillers(&cur, killers);
+
+    if (readTag(&cur) == 'X') {
+        *bml = getBoardlist(BLACK, 1);
+        (*bml)->stipIn = NOSTIP;
+    } else {
+        cur--;
+        *bml = restoreList(b, &cur);
+    }
+
+    return true;
+}
@@ -86,10 +86,6 @@ int featsort(const void* a, const void* b)
     char** aa = (char**) a;
     char** bb = (char**) b;
 
-#ifdef MOVESTAT
-    fprintf(stderr, "%s\n%s\n\n", *aa, *bb);
-#endif
-
     return strcmp(*aa, *bb);
 }
 
@@ -104,11 +100,6 @@ void class_direct_2(DIR_SOL* insol, BOARD* inBrd)
     p_init_idbd = getIdBoard();
     setup_id_board(inBrd, p_init_idbd);
 
-#ifdef MOVESTAT
-    fprintf(stderr, "WHITE_ID => %s\n", p_init_idbd->white_ids);
-    fprintf(stderr, "BLACK_ID => %s\n", p_init_idbd->black_ids);
-#endif
-
     if (inBrd->check == false) {
         do_sets(insol, inBrd, p_init_idbd);
     }
@@ -13,6 +13,7 @@
  *	Input is taken from the program options and output is xml on stdout.
  *
  *	This is the module for preparing the xml output of classifications of directmates in two.
+ *	With --output=jsonl or bin the same elements go into the output record instead.
  *
  * MesonClass
  * 	Static
@@ -35,6 +36,8 @@
 #include "genx.h"
 #include "utstring.h"
 
+extern enum OUTPUT opt_output;
+
 static genxWriter w;
 static const unsigned char mc[] = "MesonClass";
 static const unsigned char stat[] = "Static";
@@ -58,262 +61,239 @@ static const unsigned char added[] = "Added";
 static const unsigned char changed[] = "Changed";
 static const unsigned char removed[] = "Removed";
 
-void start_class_2_xml()
+static void startClass(const unsigned char* name)
 {
-    w = genxNew(NULL, NULL, NULL);
-    (void) genxStartDocFile(w, stdout);
-    (void) genxStartElementLiteral(w, NULL, mc);
+    if (opt_output == OUT_XML) {
+        (void) genxStartElementLiteral(w, NULL, name);
+    } else {
+        rec_class_start((const char*) name);
+    }
+
     return;
 }
 
-void end_class_2_xml()
+static void endClass(void)
 {
-    (void) genxEndElement(w);
-    (void) genxEndDocument(w);
-    genxDispose(w);
-    printf("\n");
+    if (opt_output == OUT_XML) {
+        (void) genxEndElement(w);
+    } else {
+        rec_class_end();
+    }
 
     return;
 }
 
-void start_static_class_xml()
+static void addClassText(const unsigned char* name, char* text)
 {
-    (void) genxStartElementLiteral(w, NULL, stat);
+    if (opt_output == OUT_XML) {
+        (void) genxStartElementLiteral(w, NULL, name);
+        (void) genxAddText(w, (unsigned char*) text);
+        (void) genxEndElement(w);
+    } else {
+        rec_class_text((const char*) name, text);
+    }
 
     return;
 }
 
-void add_added(int inInt)
+static void addClassInt(const unsigned char* name, int inInt)
 {
     UT_string* s;
 
-    utstring_new(s);
+    if (opt_output != OUT_XML) {
+        rec_class_int((const char*) name, inInt);
+        return;
+    }
 
-    (void) genxStartElementLiteral(w, NULL, added);
+    utstring_new(s);
     utstring_printf(s, "%d", inInt);
-    (void) genxAddText(w, (unsigned char*) utstring_body(s));
-    (void) genxEndElement(w);
-
+    addClassText(name, utstring_body(s));
     utstring_free(s);
 
     return;
 }
 
-void add_removed(int inInt)
+void start_class_2_xml()
 {
-    UT_string* s;
+    if (opt_output == OUT_XML) {
+        w = genxNew(NULL, NULL, NULL);
+        (void) genxStartDocFile(w, stdout);
+    }
 
-    utstring_new(s);
+    startClass(mc);
+    return;
+}
 
-    (void) genxStartElementLiteral(w, NULL, removed);
-    utstring_printf(s, "%d", inInt);
-    (void) genxAddText(w, (unsigned char*) utstring_body(s));
-    (void) genxEndElement(w);
+void end_class_2_xml()
+{
+    endClass();
 
-    utstring_free(s);
+    if (opt_output == OUT_XML) {
+        (void) genxEndDocument(w);
+        genxDispose(w);
+        printf("\n");
+    }
 
     return;
 }
 
-void add_changed(int inInt)
+void start_static_class_xml()
 {
-    UT_string* s;
-
-    utstring_new(s);
+    startClass(stat);
 
-    (void) genxStartElementLiteral(w, NULL, changed);
-    utstring_printf(s, "%d", inInt);
-    (void) genxAddText(w, (unsigned char*) utstring_body(s));
-    (void) genxEndElement(w);
+    return;
+}
 
-    utstring_free(s);
+void add_added(int inInt)
+{
+    addClassInt(added, inInt);
 
     return;
 }
 
-void add_up_flights(int inInt)
+void add_removed(int inInt)
 {
-    UT_string* s;
+    addClassInt(removed, inInt);
 
-    utstring_new(s);
-
-    (void) genxStartElementLiteral(w, NULL, up_flights);
-    utstring_printf(s, "%d", inInt);
-    (void) genxAddText(w, (unsigned char*) utstring_body(s));
-    (void) genxEndElement(w);
+    return;
+}
 
-    utstring_free(s);
+void add_changed(int inInt)
+{
+    addClassInt(changed, inInt);
 
     return;
 }
 
-void add_up_checks(int inInt)
+void add_up_flights(int inInt)
 {
-    UT_string* s;
+    addClassInt(up_flights, inInt);
 
-    utstring_new(s);
-
-    (void) genxStartElementLiteral(w, NULL, up_checks);
-    utstring_printf(s, "%d", inInt);
-    (void) genxAddText(w, (unsigned char*) utstring_body(s));
-    (void) genxEndElement(w);
+    return;
+}
 
-    utstring_free(s);
+void add_up_checks(int inInt)
+{
+    addClassInt(up_checks, inInt);
 
     return;
 }
 
 void add_up_fgivers(int inInt)
 {
-    UT_string* s;
-
-    utstring_new(s);
-
-    (void) genxStartElementLiteral(w, NULL, up_fgivers);
-    utstring_printf(s, "%d", inInt);
-    (void) genxAddText(w, (unsigned char*) utstring_body(s));
-    (void) genxEndElement(w);
-
-    utstring_free(s);
+    addClassInt(up_fgivers, inInt);
 
     return;
 }
 
 void add_up_caps(int inInt)
 {
-    UT_string* s;
-
-    utstring_new(s);
-
-    (void) genxStartElementLiteral(w, NULL, up_caps);
-    utstring_printf(s, "%d", inInt);
-    (void) genxAddText(w, (unsigned char*) utstring_body(s));
-    (void) genxEndElement(w);
-
-    utstring_free(s);
+    addClassInt(up_caps, inInt);
 
     return;
 }
 
 void add_tot_up(int inInt)
 {
-    UT_string* s;
-
-    utstring_new(s);
-
-    (void) genxStartElementLiteral(w, NULL, tot_up);
-    utstring_printf(s, "%d", inInt);
-    (void) genxAddText(w, (unsigned char*) utstring_body(s));
-    (void) genxEndElement(w);
-
-    utstring_free(s);
+    addClassInt(tot_up, inInt);
 
     return;
 }
 
 void add_static_type(char* in_type)
 {
-    (void) genxStartElementLiteral(w, NULL, type);
-    (void) genxAddText(w, (unsigned char*) in_type);
-    (void) genxEndElement(w);
+    addClassText(type, in_type);
 
     return;
 }
 
 void end_static_clas_xml()
 {
-    (void) genxEndElement(w);
+    endClass();
 
     return;
 }
 
 void start_set_class_xml()
 {
-    (void) genxStartElementLiteral(w, NULL, set);
+    startClass(set);
 
     return;
 }
 
 void end_set_class_xml()
 {
-    (void) genxEndElement(w);
+    endClass();
 
     return;
 }
 
 void start_virtual_class_xml()
 {
-    (void) genxStartElementLiteral(w, NULL, virt);
+    startClass(virt);
 
     return;
 }
 
 void end_virtual_class_xml()
 {
-    (void) genxEndElement(w);
+    endClass();
 
     return;
 }
 
 void start_actual_class_xml()
 {
-    (void) genxStartElementLiteral(w, NULL, act);
+    startClass(act);
 
     return;
 }
 
 void end_actual_class_xml(void)
 {
-    (void) genxEndElement(w);
+    endClass();
 
     return;
 }
 
 void add_var(char* in_var)
 {
-    (void) genxStartElementLiteral(w, NULL, var);
-    (void) genxAddText(w, (unsigned char*) in_var);
-    (void) genxEndElement(w);
+    addClassText(var, in_var);
 
     return;
 }
 
 void start_try()
 {
-    (void) genxStartElementLiteral(w, NULL, try);
+    startClass(try);
 
     return;
 }
 
 void end_try()
 {
-    (void) genxEndElement(w);
+    endClass();
 
     return;
 }
 
 void add_key(char* in_key)
 {
-    (void) genxStartElementLiteral(w, NULL, key);
-    (void) genxAddText(w, (unsigned char*) in_key);
-    (void) genxEndElement(w);
+    addClassText(key, in_key);
 
     return;
 }
+
 void add_threat(char* in_thr)
 {
-    (void) genxStartElementLiteral(w, NULL, thr);
-    (void) genxAddText(w, (unsigned char*) in_thr);
-    (void) genxEndElement(w);
+    addClassText(thr, in_thr);
 
     return;
 }
 
 void add_refut(char* in_refut)
 {
-    (void) genxStartElementLiteral(w, NULL, refut);
-    (void) genxAddText(w, (unsigned char*) in_refut);
-    (void) genxEndElement(w);
+    addClassText(refut, in_refut);
 
     return;
 }
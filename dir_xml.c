@@ -12,11 +12,11 @@
  *
  *	Input is taken from the program options and output is xml on stdout.
  *
- *	This is the module for preparing the xml output for directmates.
+ *	This is the module for preparing the xml output for directmates and
+ *	helpmates.
  */
 
 #include "sengine.h"
-#include "genx.h"
 
 extern bool opt_meson;
 extern char* opt_kings;
@@ -37,8 +37,31 @@ extern bool opt_actual;
 extern enum THREATS opt_threats;
 extern bool opt_fleck;
 extern bool opt_shortvars;
-
-static genxWriter w;
+extern unsigned int opt_memory;
+extern unsigned int opt_timelimit;
+extern uint64_t opt_nodelimit;
+extern unsigned int opt_shard;
+extern unsigned int opt_shards;
+extern bool opt_dag;
+
+typedef struct SHARED_VAR {
+    uint64_t content;
+    BOARDLIST* list;             /* The first list seen with this variation. */
+    struct SHARED_VAR* next;     /* Another variation with the same content hash. */
+    unsigned int reached;
+    unsigned int id;
+    UT_hash_handle hh;
+} SHARED_VAR;
+
+typedef struct SHARED_LIST {
+    BOARDLIST* list;
+    SHARED_VAR* var;
+    UT_hash_handle hh;
+} SHARED_LIST;
+
+static SHARED_LIST* shared = NULL;
+static SHARED_VAR* variations = NULL;
+static unsigned int shared_ids = 0;
 static const unsigned char ms[] = "MesonSolution";
 static const unsigned char solvetime[] = "SolvingTime";
 static const unsigned char program[] = "Program";
@@ -48,6 +71,8 @@ static const unsigned char diag[] = "Diagram";
 static const unsigned char keysel[] = "Keys";
 static const unsigned char setsel[] = "Sets";
 static const unsigned char trysel[] = "Tries";
+static const unsigned char unresel[] = "Unresolved";
+static const unsigned char helpsolsel[] = "Solutions";
 static const unsigned char optsel[] = "options";
 static const unsigned char statsel[] = "stats";
 static const unsigned char wmel[] = "wm";
@@ -66,69 +91,115 @@ static const unsigned char actualel[] = "actual";
 static const unsigned char threatsel[] = "threats";
 static const unsigned char fleckel[] = "fleck";
 static const unsigned char shortvarsel[] = "shortvars";
+static const unsigned char memoryel[] = "memory";
+static const unsigned char timelimitel[] = "timelimit";
+static const unsigned char nodelimitel[] = "nodelimit";
+static const unsigned char shardel[] = "shard";
+static const unsigned char dagel[] = "dag";
+static const unsigned char idattr[] = "id";
+static const unsigned char refattr[] = "ref";
+static const unsigned char degradedattr[] = "degraded";
 static const unsigned char addedel[] = "hash_added";
 static const unsigned char hitnullel[] = "hash_hit_null";
 static const unsigned char hitlistel[] = "hash_hit_list";
+static const unsigned char wnodesel[] = "white_nodes";
+static const unsigned char bnodesel[] = "black_nodes";
+static const unsigned char genel[] = "moves_generated";
+static const unsigned char attacksel[] = "attacks_calls";
+static const unsigned char matetestsel[] = "mate_tests";
+static const unsigned char probesel[] = "tt_probes";
+static const unsigned char hitsel[] = "tt_hits";
+static const unsigned char symhitsel[] = "tt_sym_hits";
+static const unsigned char storesel[] = "tt_stores";
+static const unsigned char replel[] = "tt_replacements";
+static const unsigned char killerel[] = "killer_hits";
+static const unsigned char threathitsel[] = "threat_hits";
+static const unsigned char tbcutel[] = "tb_cutoffs";
+static const unsigned char intelcutel[] = "intel_cutoffs";
+static const unsigned char boardpkel[] = "board_peak";
+static const unsigned char pospkel[] = "position_peak";
+static const unsigned char blistpkel[] = "boardlist_peak";
+static const unsigned char hvalpkel[] = "hashvalue_peak";
+static const unsigned char mempkel[] = "memory_peak";
+static const unsigned char phasesel[] = "phases";
+static const unsigned char wallel[] = "wall";
+static const unsigned char cpuel[] = "cpu";
 static const unsigned char compel[] = "compiler";
 static const unsigned char platform[] = "platform";
 
 void getWmoveXML(BOARDLIST*);
 void getBmoveXML(BOARDLIST*);
 
-void start_dir(void)
+void start_dir(bool degraded)
 {
     char progText[200];
-    w = genxNew(NULL, NULL, NULL);
-    (void) genxStartDocFile(w, stdout);
-    (void) genxStartElementLiteral(w, NULL, ms);
-    (void) genxStartElementLiteral(w, NULL, program);
+    xmlStartDoc(stdout);
+    xmlStartElement(ms);
+    xmlStartElement(program);
     (void) sprintf(progText, "%s (v. %s, %s)", PROGRAM_NAME, PROGRAM_VERSION,
                    PROGRAM_YEAR);
-    (void) genxAddText(w, (unsigned char*) progText);
-    (void) genxEndElement(w);
+    xmlAddText(progText);
+    xmlEndElement();
 
     if (opt_meson == false) {
-        (void) genxStartElementLiteral(w, NULL, author);
-        (void) genxAddText(w, (unsigned char*) PROGRAM_AUTHOR);
-        (void) genxEndElement(w);
-        (void) genxStartElementLiteral(w, NULL, compel);
+        xmlStartElement(author);
+        xmlAddText(PROGRAM_AUTHOR);
+        xmlEndElement();
+        xmlStartElement(compel);
         (void) sprintf(progText, "%s (v %s)", COMP, CV);
-        (void) genxAddText(w, (unsigned char*) progText);
-        (void) genxEndElement(w);
-        (void) genxStartElementLiteral(w, NULL, platform);
-        (void) genxAddText(w, (unsigned char*) PLATFORM);
-        (void) genxEndElement(w);
-        (void) genxStartElementLiteral(w, NULL, diag);
+        xmlAddText(progText);
+        xmlEndElement();
+        xmlStartElement(platform);
+        xmlAddText(PLATFORM);
+        xmlEndElement();
+        xmlStartElement(diag);
         (void) sprintf(progText, "%s:%s:%s", opt_kings, opt_gbr, opt_pos);
-        (void) genxAddText(w, (unsigned char*) progText);
-        (void) genxEndElement(w);
+        xmlAddText(progText);
+        xmlEndElement();
     }
 
-    (void) genxStartElementLiteral(w, NULL, soundel);
+    xmlStartElement(soundel);
+
+    if (degraded == true) {
+        // The --memory budget cost the search, so this may differ from a full run.
+        xmlAddAttribute(degradedattr, "true");
+    }
 
     switch (sound) {
     case UNSET:
-        (void) genxAddText(w, (unsigned char*) "UNSET");
+        xmlAddText("UNSET");
         break;
 
     case SHORT_SOLUTION:
-        (void) genxAddText(w, (unsigned char*) "SHORT_SOLUTION");
+        xmlAddText("SHORT_SOLUTION");
         break;
 
     case SOUND:
-        (void) genxAddText(w, (unsigned char*) "SOUND");
+        xmlAddText("SOUND");
         break;
 
     case COOKED:
-        (void) genxAddText(w, (unsigned char*) "COOKED");
+        xmlAddText("COOKED");
         break;
 
     case NO_SOLUTION:
-        (void) genxAddText(w, (unsigned char*) "NO_SOLUTION");
+        xmlAddText("NO_SOLUTION");
         break;
 
     case MISSING_SOLUTION:
-        (void) genxAddText(w, (unsigned char*) "MISSING_SOLUTION");
+        xmlAddText("MISSING_SOLUTION");
+        break;
+
+    case RESOURCE_LIMIT:
+        xmlAddText("RESOURCE_LIMIT");
+        break;
+
+    case TIMEOUT:
+        xmlAddText("TIMEOUT");
+        break;
+
+    case PARTIAL:
+        xmlAddText("PARTIAL");
         break;
 
     default:
@@ -137,44 +208,244 @@ void start_dir(void)
         break;
     }
 
-    (void) genxEndElement(w);
+    xmlEndElement();
     return;
 }
 void add_dir_set(BOARDLIST* bml)
 {
-    (void) genxStartElementLiteral(w, NULL, setsel);
+    xmlStartElement(setsel);
     getBmoveXML(bml);
-    (void) genxEndElement(w);
+    xmlEndElement();
     return;
 }
 
 void add_dir_tries(BOARDLIST* wml)
 {
-    (void) genxStartElementLiteral(w, NULL, trysel);
+    xmlStartElement(trysel);
     getWmoveXML(wml);
-    (void) genxEndElement(w);
+    xmlEndElement();
+    return;
+}
+
+static uint64_t hashText(uint64_t h, const char* text)
+{
+    while (*text != '\0') {
+        h ^= (unsigned char) * text++;
+        h *= 0x100000001b3ULL;
+    }
+
+    return h;
+}
+
+static SHARED_VAR* hashShared(BOARDLIST*);
+
+/*
+ * Whether two lists would be written identically. The lists below them
+ * have been given their variations already, so those are compared by
+ * identity.
+ */
+static bool sameVariation(BOARDLIST* a, BOARDLIST* b)
+{
+    BOARD* x;
+    BOARD* y;
+    char xmove[MOVESTR_LEN];
+    char ymove[MOVESTR_LEN];
+
+    if ((a->toPlay != b->toPlay) || (a->moveNumber != b->moveNumber)) {
+        return false;
+    }
+
+    for (x = a->vektor, y = b->vektor; (x != NULL) && (y != NULL);
+            x = x->next, y = y->next) {
+        if (strcmp(toStr(x, xmove), toStr(y, ymove)) != 0) {
+            return false;
+        }
+
+        if ((x->threat == NULL) != (y->threat == NULL)) {
+            return false;
+        }
+
+        if ((x->threat != NULL) && (hashShared(x->threat) != hashShared(y->threat))) {
+            return false;
+        }
+
+        if ((x->nextply == NULL) != (y->nextply == NULL)) {
+            return false;
+        }
+
+        if ((x->nextply != NULL)
+                && (hashShared(x->nextply) != hashShared(y->nextply))) {
+            return false;
+        }
+    }
+
+    return (x == NULL) && (y == NULL);
+}
+
+/*
+ * A variation's content hash covers the side to move, the move number and
+ * the text of its moves and of everything below them. It only picks the
+ * bucket: lists that would be written identically share one entry, found
+ * by comparing them, whether or not the search shared the BOARDLIST itself.
+ */
+static SHARED_VAR* hashShared(BOARDLIST* bl)
+{
+    SHARED_LIST* sl;
+    SHARED_VAR* head;
+    SHARED_VAR* sv;
+    BOARD* brd;
+    char move[MOVESTR_LEN];
+    uint64_t h = 0xcbf29ce484222325ULL;
+    HASH_FIND_PTR(shared, &bl, sl);
+
+    if (sl != NULL) {
+        return sl->var;
+    }
+
+    h ^= (uint64_t) bl->toPlay;
+    h *= 0x100000001b3ULL;
+    h ^= (uint64_t) bl->moveNumber;
+    h *= 0x100000001b3ULL;
+    DL_FOREACH(bl->vektor, brd) {
+        h = hashText(h, toStr(brd, move));
+        h = hashText(h, "(");
+
+        if (brd->threat != NULL) {
+            h ^= hashShared(brd->threat)->content;
+            h *= 0x100000001b3ULL;
+        }
+
+        h = hashText(h, "|");
+
+        if (brd->nextply != NULL) {
+            h ^= hashShared(brd->nextply)->content;
+            h *= 0x100000001b3ULL;
+        }
+
+        h = hashText(h, ")");
+    }
+    HASH_FIND(hh, variations, &h, sizeof(uint64_t), head);
+
+    for (sv = head; sv != NULL; sv = sv->next) {
+        if (sameVariation(sv->list, bl) == true) {
+            break;
+        }
+    }
+
+    if (sv == NULL) {
+        sv = (SHARED_VAR*) calloc(1, sizeof(SHARED_VAR));
+        SENGINE_MEM_ASSERT(sv);
+        sv->content = h;
+        sv->list = bl;
+
+        if (head == NULL) {
+            HASH_ADD(hh, variations, content, sizeof(uint64_t), sv);
+        } else {
+            // A hash collision, so chained behind the first
+            sv->next = head->next;
+            head->next = sv;
+        }
+    }
+
+    sl = (SHARED_LIST*) calloc(1, sizeof(SHARED_LIST));
+    SENGINE_MEM_ASSERT(sl);
+    sl->list = bl;
+    sl->var = sv;
+    HASH_ADD_PTR(shared, list, sl);
+    return sv;
+}
+
+static void countShared(BOARDLIST* bl)
+{
+    SHARED_VAR* sv = hashShared(bl);
+    BOARD* brd;
+
+    if (sv->reached++ > 0) {
+        // Written once already, so nothing below is reached again
+        return;
+    }
+
+    DL_FOREACH(bl->vektor, brd) {
+        if (brd->threat != NULL) {
+            countShared(brd->threat);
+        }
+
+        if (brd->nextply != NULL) {
+            countShared(brd->nextply);
+        }
+    }
+    return;
+}
+
+/*
+ * For --dag, a variation reached from more than one parent is written in
+ * full under the first, whose element gets an id attribute, and every
+ * later parent gets a ref attribute to it instead of the moves.
+ */
+void share_dir_lists(DIR_SOL* dsol)
+{
+    if (dsol->set != NULL) {
+        countShared(dsol->set);
+    }
+
+    if (dsol->tries != NULL) {
+        countShared(dsol->tries);
+    }
+
+    if (dsol->keys != NULL) {
+        countShared(dsol->keys);
+    }
+
+    if (dsol->unresolved != NULL) {
+        countShared(dsol->unresolved);
+    }
+
     return;
 }
 
+static bool addSharedAttribute(BOARDLIST* bl)
+{
+    SHARED_LIST* sl;
+    SHARED_VAR* sv;
+    char id[12];
+    HASH_FIND_PTR(shared, &bl, sl);
+
+    if ((sl == NULL) || (sl->var->reached < 2)) {
+        return true;
+    }
+
+    sv = sl->var;
+
+    if (sv->id != 0) {
+        (void) sprintf(id, "%u", sv->id);
+        xmlAddAttribute(refattr, id);
+        return false;
+    }
+
+    sv->id = ++shared_ids;
+    (void) sprintf(id, "%u", sv->id);
+    xmlAddAttribute(idattr, id);
+    return true;
+}
+
 void getBmoveXML(BOARDLIST* bList)
 {
     BOARDLIST* wList;
     BOARD* brd;
-    char* ptr;
+    bool expand;
     assert(bList != NULL);
     DL_FOREACH(bList->vektor, brd) {
         assert(brd != NULL);
-        (void) genxStartElementLiteral(w, NULL, bmel);
-        ptr = toStr(brd);
-        (void) genxAddText(w, (unsigned char*) ptr);
-        free(ptr);
+        xmlStartElement(bmel);
         wList = brd->nextply;
+        expand = (wList != NULL) ? addSharedAttribute(wList) : false;
+        xmlAddMove(brd);
 
-        if (wList != NULL) {
+        if (expand == true) {
             getWmoveXML(wList);
         }
 
-        (void) genxEndElement(w);
+        xmlEndElement();
     }
     return;
 }
@@ -184,48 +455,85 @@ void getWmoveXML(BOARDLIST* wbl)
     BOARDLIST* thList;
     BOARDLIST* bList;
     BOARD* brd;
-    char* ptr;
+    bool expand;
     assert(wbl != NULL);
     DL_FOREACH(wbl->vektor, brd) {
         assert(brd != NULL);
-        (void) genxStartElementLiteral(w, NULL, wmel);
-        ptr = toStr(brd);
-        (void) genxAddText(w, (unsigned char*) ptr);
-        free(ptr);
+        xmlStartElement(wmel);
+        bList = brd->nextply;
+        expand = (bList != NULL) ? addSharedAttribute(bList) : false;
+        xmlAddMove(brd);
         thList = brd->threat;
 
         if (thList != NULL) {
-            (void) genxStartElementLiteral(w, NULL, threl);
-            getWmoveXML(thList);
-            (void) genxEndElement(w);
-        }
+            xmlStartElement(threl);
 
-        bList = brd->nextply;
+            if (addSharedAttribute(thList) == true) {
+                getWmoveXML(thList);
+            }
+
+            xmlEndElement();
+        }
 
-        if (bList != NULL) {
+        if (expand == true) {
             getBmoveXML(bList);
         }
 
-        (void) genxEndElement(w);
+        xmlEndElement();
     }
     return;
 }
 
 void add_dir_keys(BOARDLIST* wml)
 {
-    (void) genxStartElementLiteral(w, NULL, keysel);
+    xmlStartElement(keysel);
+    getWmoveXML(wml);
+    xmlEndElement();
+    return;
+}
+
+void add_dir_unresolved(BOARDLIST* wml)
+{
+    xmlStartElement(unresel);
     getWmoveXML(wml);
-    (void) genxEndElement(w);
+    xmlEndElement();
+    return;
+}
+
+/*
+ * A helpmate's solutions start with Black's move, so the tree is written
+ * from its black moves down.
+ */
+void add_help_sols(BOARDLIST* bml)
+{
+    xmlStartElement(helpsolsel);
+    getBmoveXML(bml);
+    xmlEndElement();
     return;
 }
 
 void end_dir(void)
 {
+    SHARED_LIST* sl;
+    SHARED_LIST* tmp;
+    SHARED_VAR* sv;
+    SHARED_VAR* tmpv;
     //( void ) puts( "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" );
-    (void) genxEndElement(w);
-    (void) genxEndDocument(w);
-    genxDispose(w);
+    xmlEndDoc();
     printf("\n");
+    HASH_ITER(hh, shared, sl, tmp) {
+        HASH_DEL(shared, sl);
+        free(sl);
+    }
+    HASH_ITER(hh, variations, sv, tmpv) {
+        HASH_DEL(variations, sv);
+
+        while (sv != NULL) {
+            SHARED_VAR* nv = sv->next;
+            free(sv);
+            sv = nv;
+        }
+    }
     return;
 }
 void add_dir_options(void)
@@ -235,7 +543,7 @@ void add_dir_options(void)
     char sols[2];
     unsigned char on[] = "true";
     unsigned char off[] = "false";
-    (void) genxStartElementLiteral(w, NULL, optsel);
+    xmlStartElement(optsel);
     // stip
     stip[0] = '\0';
 
@@ -244,15 +552,15 @@ void add_dir_options(void)
         break;
 
     case HELP:
-        stip[1] = 'H';
+        (void) strcpy(stip, "H");
         break;
 
     case SELF:
-        stip[1] = 'S';
+        (void) strcpy(stip, "S");
         break;
 
     case REFLEX:
-        stip[1] = 'R';
+        (void) strcpy(stip, "R");
         break;
 
     default:
@@ -260,155 +568,284 @@ void add_dir_options(void)
     }
 
     (void) strcat(stip, (opt_aim == MATE) ? "#" : "=");
-    (void) genxStartElementLiteral(w, NULL, stipel);
-    (void) genxAddText(w, (unsigned char*) stip);
-    (void) genxEndElement(w);
+    xmlStartElement(stipel);
+    xmlAddText(stip);
+    xmlEndElement();
     // moves
-    (void) genxStartElementLiteral(w, NULL, movesel);
+    xmlStartElement(movesel);
     moves[0] = (char) opt_moves + '0';
     moves[1] = '\0';
-    (void) genxAddText(w, (unsigned char*) moves);
-    (void) genxEndElement(w);
+    xmlAddText(moves);
+    xmlEndElement();
     // sols
-    (void) genxStartElementLiteral(w, NULL, solsel);
+    xmlStartElement(solsel);
     sols[0] = (char) opt_sols + '0';
     sols[1] = '\0';
-    (void) genxAddText(w, (unsigned char*) sols);
-    (void) genxEndElement(w);
+    xmlAddText(sols);
+    xmlEndElement();
     // castling
-    (void) genxStartElementLiteral(w, NULL, castel);
+    xmlStartElement(castel);
 
     if (opt_castling != NULL) {
-        (void) genxAddText(w, (unsigned char*) opt_castling);
+        xmlAddText(opt_castling);
     }
 
-    (void) genxEndElement(w);
+    xmlEndElement();
     // ep
-    (void) genxStartElementLiteral(w, NULL, epel);
+    xmlStartElement(epel);
 
     if (opt_ep != NULL) {
-        (void) genxAddText(w, (unsigned char*) opt_ep);
+        xmlAddText(opt_ep);
     }
 
-    (void) genxEndElement(w);
+    xmlEndElement();
     // set
-    (void) genxStartElementLiteral(w, NULL, setel);
+    xmlStartElement(setel);
 
     if (opt_set == true) {
-        (void) genxAddText(w, on);
+        xmlAddText((const char*) on);
     } else {
-        (void) genxAddText(w, off);
+        xmlAddText((const char*) off);
     }
 
-    (void) genxEndElement(w);
+    xmlEndElement();
     // tries
-    (void) genxStartElementLiteral(w, NULL, triesel);
+    xmlStartElement(triesel);
 
     if (opt_tries == true) {
-        (void) genxAddText(w, on);
+        xmlAddText((const char*) on);
     } else {
-        (void) genxAddText(w, off);
+        xmlAddText((const char*) off);
     }
 
-    (void) genxEndElement(w);
+    xmlEndElement();
     // refuts
-    (void) genxStartElementLiteral(w, NULL, refutsel);
+    xmlStartElement(refutsel);
     sols[0] = (char) opt_refuts + '0';
     sols[1] = '\0';
-    (void) genxAddText(w, (unsigned char*) sols);
-    (void) genxEndElement(w);
+    xmlAddText(sols);
+    xmlEndElement();
     // trivialtries
-    (void) genxStartElementLiteral(w, NULL, trivialtriesel);
+    xmlStartElement(trivialtriesel);
 
     if (opt_trivialtries == true) {
-        (void) genxAddText(w, on);
+        xmlAddText((const char*) on);
     } else {
-        (void) genxAddText(w, off);
+        xmlAddText((const char*) off);
     }
 
-    (void) genxEndElement(w);
+    xmlEndElement();
     // actual
-    (void) genxStartElementLiteral(w, NULL, actualel);
+    xmlStartElement(actualel);
 
     if (opt_actual == true) {
-        (void) genxAddText(w, on);
+        xmlAddText((const char*) on);
     } else {
-        (void) genxAddText(w, off);
+        xmlAddText((const char*) off);
     }
 
-    (void) genxEndElement(w);
+    xmlEndElement();
     // threats
-    (void) genxStartElementLiteral(w, NULL, threatsel);
+    xmlStartElement(threatsel);
 
     switch (opt_threats) {
     case ALL:
-        (void) genxAddText(w, (unsigned char*) "ALL");
+        xmlAddText("ALL");
         break;
 
     case NONE:
-        (void) genxAddText(w, (unsigned char*) "NONE");
+        xmlAddText("NONE");
         break;
 
     case SHORTEST:
-        (void) genxAddText(w, (unsigned char*) "SHORTEST");
+        xmlAddText("SHORTEST");
         break;
 
     default:
-        (void) genxAddText(w, (unsigned char*) "UNKNOWN");
+        xmlAddText("UNKNOWN");
         break;
     }
 
-    (void) genxEndElement(w);
+    xmlEndElement();
     // fleck
-    (void) genxStartElementLiteral(w, NULL, fleckel);
+    xmlStartElement(fleckel);
 
     if (opt_fleck == true) {
-        (void) genxAddText(w, on);
+        xmlAddText((const char*) on);
     } else {
-        (void) genxAddText(w, off);
+        xmlAddText((const char*) off);
     }
 
-    (void) genxEndElement(w);
+    xmlEndElement();
     // shortvars
-    (void) genxStartElementLiteral(w, NULL, shortvarsel);
+    xmlStartElement(shortvarsel);
 
     if (opt_shortvars == true) {
-        (void) genxAddText(w, on);
+        xmlAddText((const char*) on);
     } else {
-        (void) genxAddText(w, off);
+        xmlAddText((const char*) off);
+    }
+
+    xmlEndElement();
+    // memory
+
+    if (opt_memory != 0) {
+        char mem[12];
+        xmlStartElement(memoryel);
+        (void) sprintf(mem, "%u", opt_memory);
+        xmlAddText(mem);
+        xmlEndElement();
+    }
+
+    // limits
+
+    if (opt_timelimit != 0) {
+        char secs[12];
+        xmlStartElement(timelimitel);
+        (void) sprintf(secs, "%u", opt_timelimit);
+        xmlAddText(secs);
+        xmlEndElement();
+    }
+
+    if (opt_nodelimit != 0) {
+        char nodes[24];
+        xmlStartElement(nodelimitel);
+        (void) sprintf(nodes, "%llu", (unsigned long long) opt_nodelimit);
+        xmlAddText(nodes);
+        xmlEndElement();
     }
 
-    (void) genxEndElement(w);
-    (void) genxEndElement(w);
+    // shard
+
+    if (opt_shards != 0) {
+        char shard[12];
+        xmlStartElement(shardel);
+        (void) sprintf(shard, "%u/%u", opt_shard, opt_shards);
+        xmlAddText(shard);
+        xmlEndElement();
+    }
+
+    // dag
+
+    if (opt_dag == true) {
+        xmlStartElement(dagel);
+        xmlAddText((const char*) on);
+        xmlEndElement();
+    }
+
+    xmlEndElement();
     return;
 }
 
-void add_dir_stats(DIR_SOL* dsol)
+static void addCounter(const unsigned char* el, uint64_t count)
+{
+    char temp[24];
+    xmlStartElement(el);
+    (void) sprintf(temp, "%" PRIu64, count);
+    xmlAddText(temp);
+    xmlEndElement();
+    return;
+}
+
+static void addNodes(const unsigned char* el, enum COLOUR side)
+{
+    char temp[24];
+    unsigned int ply;
+    unsigned int last = ((unsigned int) opt_moves < STATS_PLIES) ? (unsigned int) opt_moves : STATS_PLIES - 1;
+    xmlStartElement(el);
+
+    for (ply = 1; ply <= last; ply++) {
+        (void) sprintf(temp, "%s%" PRIu64, (ply == 1) ? "" : " ",
+                       stats.nodes[side][ply]);
+        xmlAddText(temp);
+    }
+
+    xmlEndElement();
+    return;
+}
+
+static void addPhases(void)
+{
+    char temp[24];
+    int ph;
+    xmlStartElement(phasesel);
+
+    for (ph = 0; ph < PHASES; ph++) {
+        xmlStartElement((const unsigned char*) phase_names[ph]);
+        xmlStartElement(wallel);
+        (void) sprintf(temp, "%f", stats.wall[ph]);
+        xmlAddText(temp);
+        xmlEndElement();
+        xmlStartElement(cpuel);
+        (void) sprintf(temp, "%f", stats.cpu[ph]);
+        xmlAddText(temp);
+        xmlEndElement();
+        xmlEndElement();
+    }
+
+    xmlEndElement();
+    return;
+}
+
+static void addStats(unsigned int added, unsigned int hit_null, unsigned int hit_list)
 {
     char temp[20];
-    (void) genxStartElementLiteral(w, NULL, statsel);
-    (void) genxStartElementLiteral(w, NULL, addedel);
-    (void) sprintf(temp, "%u", dsol->hash_added);
-    (void) genxAddText(w, (unsigned char*) temp);
-    (void) genxEndElement(w);
-    (void) genxStartElementLiteral(w, NULL, hitnullel);
-    (void) sprintf(temp, "%u", dsol->hash_hit_null);
-    (void) genxAddText(w, (unsigned char*) temp);
-    (void) genxEndElement(w);
-    (void) genxStartElementLiteral(w, NULL, hitlistel);
-    (void) sprintf(temp, "%u", dsol->hash_hit_list);
-    (void) genxAddText(w, (unsigned char*) temp);
-    (void) genxEndElement(w);
-    (void) genxEndElement(w);
+    xmlStartElement(statsel);
+    xmlStartElement(addedel);
+    (void) sprintf(temp, "%u", added);
+    xmlAddText(temp);
+    xmlEndElement();
+    xmlStartElement(hitnullel);
+    (void) sprintf(temp, "%u", hit_null);
+    xmlAddText(temp);
+    xmlEndElement();
+    xmlStartElement(hitlistel);
+    (void) sprintf(temp, "%u", hit_list);
+    xmlAddText(temp);
+    xmlEndElement();
+    addNodes(wnodesel, WHITE);
+    addNodes(bnodesel, BLACK);
+    addCounter(genel, stats.moves_generated);
+    addCounter(attacksel, stats.attacks_calls);
+    addCounter(matetestsel, stats.mate_tests);
+    addCounter(probesel, stats.tt_probes);
+    addCounter(hitsel, stats.tt_hits);
+    addCounter(symhitsel, stats.tt_sym_hits);
+    addCounter(storesel, stats.tt_stores);
+    addCounter(replel, stats.tt_replacements);
+    addCounter(killerel, stats.killer_hits);
+    addCounter(threathitsel, stats.threat_hits);
+    addCounter(tbcutel, stats.tb_cutoffs);
+    addCounter(intelcutel, stats.intel_cutoffs);
+    addCounter(boardpkel, stats.board_peak);
+    addCounter(pospkel, stats.position_peak);
+    addCounter(blistpkel, stats.boardlist_peak);
+    addCounter(hvalpkel, stats.hashvalue_peak);
+    addCounter(mempkel, stats.mem_peak);
+    addPhases();
+    xmlEndElement();
+    return;
+}
+
+void add_dir_stats(DIR_SOL* dsol)
+{
+    addStats(dsol->hash_added, dsol->hash_hit_null, dsol->hash_hit_list);
+    return;
+}
+
+// The helpmate table only ever holds positions with no solution.
+void add_help_stats(HELP_SOL* hsol)
+{
+    addStats(hsol->hash_added, hsol->hash_hit_null, 0);
     return;
 }
 
 void time_dir(double st)
 {
     char timeText[50];
-    (void) genxStartElementLiteral(w, NULL, solvetime);
+    xmlStartElement(solvetime);
     (void) sprintf(timeText, "%f", st);
-    (void) genxAddText(w, (unsigned char*) timeText);
-    (void) genxEndElement(w);
+    xmlAddText(timeText);
+    xmlEndElement();
     return;
 }
@@ -30,11 +30,14 @@ extern enum AIM opt_aim;
 extern unsigned int opt_refuts;
 extern bool opt_shortvars;
 extern bool opt_fleck;
-
-#ifdef MOVESTAT
-static char toPiece(enum PIECE);
-char* toSquare(int);
-#endif
+extern unsigned int opt_timelimit;
+extern uint64_t opt_nodelimit;
+extern unsigned int opt_shard;
+extern unsigned int opt_shards;
+extern bool opt_intelligent;
+extern char* opt_twins;
+extern bool opt_quick;
+extern bool opt_meson;
 
 void setup_mpool();
 void destroy_mpool();
@@ -58,6 +61,18 @@ static BOARDLIST* norm_whiteMidMove(BOARD*, int);
 static BOARDLIST* blackMove(BOARD*);
 static BOARDLIST* norm_blackMidMove(BOARD*, int);
 static void walkWBoardList(BOARDLIST*);
+static BOARDLIST* threatMove(BOARD*, int);
+static BOARDLIST* mapList(BOARDLIST*, BOARD*, unsigned char, unsigned char);
+static void countNode(BOARD*);
+static BOARDLIST* earlyRefutation(BOARD*, enum COLOUR, int);
+static bool outOfResources(BOARD*);
+static bool roomInTable(void);
+static double elapsed(void);
+static void evictTransTable(void);
+static void dropPosition(BOARD*);
+static void trimTry(BOARD*);
+static void shedMemory(void);
+static void shedTree(BOARDLIST*, bool, bool);
 
 static bool isFlight(BOARD*);
 static bool isCheck(BOARD*);
@@ -73,15 +88,19 @@ static unsigned int hash_added = 0;
 static unsigned int hash_hit_null = 0;
 static unsigned int hash_hit_list = 0;
 static HASHVALUE* transtable = NULL;
+static HASHVALUE* threattable = NULL;
 static KILLERHASHVALUE* killers = NULL;
-
-#ifdef MOVESTAT
-static char toPiece(enum PIECE inpc)
-{
-    char tr[] = "XPSBRQK";
-    return tr[inpc];
-}
-#endif
+static bool keep_positions;
+static bool aborted = false;
+static enum SOUNDNESS stop_reason = UNSET;
+static uint64_t nodes = 0;
+static struct timespec search_start;
+static BOARDLIST* unresolved = NULL;
+static bool tt_live = false;
+static DIR_SOL* solution = NULL;
+static BOARDLIST* first_moves = NULL;
+static bool shed = false;
+static bool squeezed = false;
 
 static int whiteMoveCompare(void* a, void* b)
 {
@@ -213,6 +232,18 @@ void solve_direct(DIR_SOL* dsol, BOARD* startpos)
     bool shortsol = false;
     unsigned int m;
     sound = UNSET;
+    keep_positions = opt_classify;
+    shed = false;
+    squeezed = false;
+    solution = dsol;
+    (void) clock_gettime(CLOCK_MONOTONIC, &search_start);
+    aborted = false;
+    stop_reason = UNSET;
+    nodes = 0;
+    unresolved = NULL;
+    hash_added = 0;
+    hash_hit_null = 0;
+    hash_hit_list = 0;
 
     if ((opt_actual == true) && (opt_moves == 1)) {
         int ct;
@@ -230,14 +261,12 @@ void solve_direct(DIR_SOL* dsol, BOARD* startpos)
             sound = COOKED;
         }
     } else if ((opt_actual == true) || (opt_tries == true)) {
+        start_phase(PH_GLOSS);
+
         for (m = 1; m < opt_moves; m++) {
             int ct;
             BOARD* b;
             BOARDLIST* ml;
-#ifdef MOVESTAT
-            (void) fprintf(stderr, "Gloss %d\n", m);
-            (void) fflush(stderr);
-#endif
 
             if (m == 1) {
                 ml = gloss_final_move(startpos, 1);
@@ -245,6 +274,11 @@ void solve_direct(DIR_SOL* dsol, BOARD* startpos)
                 ml = gloss_first_move(startpos, m);
             }
 
+            if (aborted == true) {
+                freeBoardlist(ml);
+                break;
+            }
+
             DL_COUNT(ml->vektor, b, ct);
 
             if (ct > 0) {
@@ -257,26 +291,32 @@ void solve_direct(DIR_SOL* dsol, BOARD* startpos)
             }
         }
 
-        if (shortsol == false) {
+        end_phase(PH_GLOSS);
+
+        if ((shortsol == false) && (aborted == false)) {
             int ct;
             BOARD* b;
             state = TRIESKEYS;
 
-            if (opt_moves > 4) {
+            if ((opt_moves > 4) && (tt_live == false)) {
                 setup_mpool();
+                tt_live = true;
             }
 
+            start_phase(PH_TRIESKEYS);
+            open_checkpoint();
             dsol->trieskeys = norm_first_move(startpos);
+            close_checkpoint();
+            end_phase(PH_TRIESKEYS);
 
-            if (opt_threats != NONE) {
-#ifdef MOVESTAT
-                (void) fputs("Threats\n", stderr);
-                (void) fflush(stderr);
-#endif
+            if ((opt_threats != NONE) && (aborted == false)) {
                 state = THREATS;
+                start_phase(PH_THREATS);
                 calculateThreats(dsol->trieskeys);
+                end_phase(PH_THREATS);
             }
 
+            first_moves = NULL;
             sortTriesKeys(dsol);
             //dsol->keys = dsol->trieskeys;
 
@@ -284,6 +324,12 @@ void solve_direct(DIR_SOL* dsol, BOARD* startpos)
                 deTrivialise(dsol->tries);
             }
 
+            if ((opt_meson == true) && (keep_positions == false)) {
+                DL_FOREACH(dsol->tries->vektor, b) {
+                    trimTry(b);
+                }
+            }
+
             DL_COUNT(dsol->keys->vektor, b, ct);
 
             if (ct == 0) {
@@ -299,29 +345,57 @@ void solve_direct(DIR_SOL* dsol, BOARD* startpos)
     }
 
     if ((shortsol == false) && (opt_moves > 1) && (opt_set == true)
-            && (startpos->check == false)) {
-#ifdef MOVESTAT
-        (void) fputs("Set play\n", stderr);
-        (void) fflush(stderr);
-#endif
+            && (startpos->check == false) && (aborted == false)) {
         state = SETPLAY;
+        start_phase(PH_SETPLAY);
         dsol->set = calculateSetPlay(startpos);
+        end_phase(PH_SETPLAY);
 
         if (opt_threats != NONE) {
             state = THREATS;
+            start_phase(PH_SETTHREATS);
             calculateSetThreats(dsol->set);
+            end_phase(PH_SETTHREATS);
+        }
+
+        if (aborted == true) {
+            freeBoardlist(dsol->set);
+            dsol->set = NULL;
+        }
+    }
+
+    if (aborted == true) {
+        sound = stop_reason;
+    } else if ((opt_shards != 0) && (shortsol == false)) {
+        sound = PARTIAL;
+    }
+
+    if (opt_quick == true) {
+        // Only the soundness is reported.
+        if (dsol->keys != NULL) {
+            freeBoardlist(dsol->keys);
+            dsol->keys = NULL;
+        }
+
+        if (dsol->tries != NULL) {
+            freeBoardlist(dsol->tries);
+            dsol->tries = NULL;
         }
     }
 
-    if (opt_moves > 4) {
+    // Twins share the transposition table.
+    if (opt_twins == NULL) {
+        end_direct();
+    }
+
+    {
         HASHVALUE* cu;
         HASHVALUE* tmp;
-        HASH_ITER(hh, transtable, cu, tmp) {
-            HASH_DEL(transtable, cu);
-            freeHashValue(cu);
+        HASH_ITER(hh, threattable, cu, tmp) {
+            HASH_DEL(threattable, cu);
+            freeBoardlist(cu->cont);
+            free(cu);
         }
-
-        destroy_mpool();
     }
 
     {
@@ -333,12 +407,38 @@ void solve_direct(DIR_SOL* dsol, BOARD* startpos)
         }
     }
 
+    if ((unresolved != NULL) && (unresolved->vektor == NULL)) {
+        freeBoardlist(unresolved);
+        unresolved = NULL;
+    }
+
+    dsol->unresolved = unresolved;
+    dsol->degraded = squeezed;
     dsol->hash_added = hash_added;
     dsol->hash_hit_null = hash_hit_null;
     dsol->hash_hit_list = hash_hit_list;
     return;
 }
 
+void end_direct(void)
+{
+    HASHVALUE* cu;
+    HASHVALUE* tmp;
+
+    if (tt_live == false) {
+        return;
+    }
+
+    HASH_ITER(hh, transtable, cu, tmp) {
+        HASH_DEL(transtable, cu);
+        freeHashValue(cu);
+    }
+
+    destroy_mpool();
+    tt_live = false;
+    return;
+}
+
 static BOARDLIST* gloss_blackMidMove(BOARD* inBrd, int move, int lastmove)
 {
     BOARDLIST* bml;
@@ -371,6 +471,11 @@ static BOARDLIST* gloss_blackMidMove(BOARD* inBrd, int move, int lastmove)
     }
 
     DL_FOREACH(bml->vektor, m) {
+        if (outOfResources(m) == true) {
+            finished = true;
+            break;
+        }
+
         if ((move + 1) == lastmove) {
             wml = gloss_final_move(m, lastmove);
             mateIn = wml->stipIn;
@@ -389,7 +494,7 @@ static BOARDLIST* gloss_blackMidMove(BOARD* inBrd, int move, int lastmove)
             m->nextply = wml;
             qualifyMove(bml, m);
 
-            if (opt_classify == false) {
+            if (keep_positions == false) {
                 freePosition(m->pos);
                 m->pos = NULL;
             }
@@ -439,7 +544,7 @@ static BOARDLIST* gloss_whiteMidMove(BOARD* inBrd, int move, int lastmove)
                             shortStipAchieved = true;
                             m->tag = '#';
 
-                            if (opt_classify == false) {
+                            if (keep_positions == false) {
                                 freePosition(m->pos);
                                 m->pos = NULL;
                             }
@@ -469,7 +574,7 @@ static BOARDLIST* gloss_whiteMidMove(BOARD* inBrd, int move, int lastmove)
                             shortStipAchieved = true;
                             m->tag = '=';
 
-                            if (opt_classify == false) {
+                            if (keep_positions == false) {
                                 freePosition(m->pos);
                                 m->pos = NULL;
                             }
@@ -504,7 +609,7 @@ static BOARDLIST* gloss_whiteMidMove(BOARD* inBrd, int move, int lastmove)
     wml = generateWhiteBoardlist(inBrd, move);
     sortWhiteMoves(wml);
     DL_FOREACH_SAFE(wml->vektor, m, tmp) {
-        if (stipAchieved == true) {
+        if ((stipAchieved == true) || (outOfResources(m) == true)) {
             DL_DELETE(wml->vektor, m);
             freeBoard(m);
         } else {
@@ -587,6 +692,11 @@ static BOARDLIST* gloss_blackMove(BOARD* inBrd, int moves)
     }
 
     DL_FOREACH(bml->vektor, b) {
+        if (outOfResources(b) == true) {
+            stipAchieved = false;
+            break;
+        }
+
         if (moves == 2) {
             wml = gloss_final_move(b, 2);
         } else {
@@ -605,7 +715,7 @@ static BOARDLIST* gloss_blackMove(BOARD* inBrd, int moves)
             qualifyMove(bml, b);
             b->nextply = wml;
 
-            if (opt_classify == false) {
+            if (keep_positions == false) {
                 freePosition(b->pos);
                 b->pos = NULL;
             }
@@ -625,6 +735,95 @@ static BOARDLIST* gloss_blackMove(BOARD* inBrd, int moves)
     return bml;
 }
 
+/*
+ * Rebuilds a list found in a table under a symmetric position for the
+ * position actually reached. Each stored move is mapped onto this board
+ * and matched against a fresh generation from parent, so the copy has
+ * real positions, qualifiers and the order the search would have given
+ * it. Returns NULL if any stored move fails to match.
+ */
+static BOARDLIST* mapList(BOARDLIST* src, BOARD* parent, unsigned char from_sym,
+                          unsigned char to_sym)
+{
+    BOARDLIST* bl;
+    BOARD* b;
+    BOARD* s;
+    BOARD* tmp;
+    unsigned int flights;
+    unsigned char inv = symInverse(to_sym);
+    int matched = 0;
+    int ct;
+
+    if (src->toPlay == WHITE) {
+        bl = generateWhiteBoardlist(parent, src->moveNumber);
+    } else {
+        bl = generateBlackBoardlist(parent, src->moveNumber, &flights);
+    }
+
+    DL_FOREACH(bl->vektor, b) {
+        qualifyMove(bl, b);
+    }
+    DL_FOREACH_SAFE(bl->vektor, b, tmp) {
+        DL_FOREACH(src->vektor, s) {
+            if ((mapSquare(mapSquare(s->from, from_sym), inv) == b->from)
+                    && (mapSquare(mapSquare(s->to, from_sym), inv) == b->to)
+                    && (s->promotion == b->promotion)) {
+                break;
+            }
+        }
+
+        if (s == NULL) {
+            DL_DELETE(bl->vektor, b);
+            freeBoard(b);
+            continue;
+        }
+
+        matched++;
+        b->tag = s->tag;
+        b->flights = s->flights;
+        b->killer = s->killer;
+
+        if (s->nextply != NULL) {
+            b->nextply = mapList(s->nextply, b, from_sym, to_sym);
+        }
+
+        if (s->threat != NULL) {
+            b->threat = mapList(s->threat, b, from_sym, to_sym);
+        }
+
+        if (((s->nextply != NULL) && (b->nextply == NULL))
+                || ((s->threat != NULL) && (b->threat == NULL))) {
+            matched = -1;
+            break;
+        }
+
+        // Keep positions only where the search itself would have.
+        dropPosition(b);
+    }
+    DL_COUNT(src->vektor, s, ct);
+
+    if (matched != ct) {
+        freeBoardlist(bl);
+        return NULL;
+    }
+
+    bl->legalMoves = src->legalMoves;
+    bl->isTry = src->isTry;
+    bl->maxStip = src->maxStip;
+    bl->minStip = src->minStip;
+    bl->stipIn = src->stipIn;
+
+    if (bl->toPlay == BLACK) {
+        if (parent->check == false) {
+            sortStrongBlackMoves(bl);
+        }
+    } else if ((opt_moves > 3) && (src->vektor != NULL) && (src->vektor->nextply != NULL)) {
+        sortWhiteMoves(bl);
+    }
+
+    return bl;
+}
+
 static BOARDLIST* norm_blackMidMove(BOARD* inBrd, int move)
 {
     BOARDLIST* bml;
@@ -641,6 +840,12 @@ static BOARDLIST* norm_blackMidMove(BOARD* inBrd, int move)
     int ct;
     HASHKEY kp;
     assert(inBrd != NULL);
+    bml = earlyRefutation(inBrd, BLACK, move);
+
+    if (bml != NULL) {
+        return bml;
+    }
+
     bml = generateBlackBoardlist(inBrd, move, &flights);
 
     if (inBrd->check == false) {
@@ -659,6 +864,11 @@ static BOARDLIST* norm_blackMidMove(BOARD* inBrd, int move)
     }
 
     DL_FOREACH(bml->vektor, m) {
+        if (outOfResources(m) == true) {
+            refutationFound = true;
+            break;
+        }
+
         qualifyMove(bml, m);
 
         if ((move + 1) == opt_moves) {
@@ -668,23 +878,40 @@ static BOARDLIST* norm_blackMidMove(BOARD* inBrd, int move)
             if ((opt_moves > 4) && ((move == 2) || (move == 3))) {
                 HASHVALUE* ptr;
                 ishash = true;
-                getHashKey(m, &kp);
+                getHashKey(m, 0, &kp);
                 HASH_FIND(hh, transtable, &kp, MD5_LEN, ptr);
+                stats.tt_probes++;
 
                 if (ptr != NULL) {
+                    stats.tt_hits++;
+
                     if (ptr->cont == NULL) {
                         refutationFound = true;
                         hash_hit_null++;
                         break;
+                    }
+
+                    if (ptr->sym == kp.sym) {
+                        wml = ptr->cont;
+                        wml->use_count++;
                     } else {
+                        wml = mapList(ptr->cont, m, ptr->sym, kp.sym);
+                        stats.tt_sym_hits++;
+                    }
+
+                    if (wml != NULL) {
                         hash_hit_list++;
-                        ptr->cont->use_count++;
-                        mateIn = ptr->cont->stipIn;
+                        mateIn = wml->stipIn;
                         minStip = (mateIn < minStip) ? mateIn : minStip;
                         maxStip = (mateIn > maxStip) ? mateIn : maxStip;
-                        m->nextply = ptr->cont;
+                        m->nextply = wml;
                         continue;
                     }
+
+                    // The key is taken, so this result is not stored again.
+                    ishash = false;
+                    wml = norm_whiteMidMove(m, move + 1);
+                    mateIn = wml->stipIn;
                 } else {
                     wml = norm_whiteMidMove(m, move + 1);
                     mateIn = wml->stipIn;
@@ -700,25 +927,33 @@ static BOARDLIST* norm_blackMidMove(BOARD* inBrd, int move)
             freeBoardlist(wml);
             wml = NULL;
 
-            if (ishash == true) {
+            if ((ishash == true) && (aborted == false)
+                    && roomInTable()) {
                 HASHVALUE* hv = getHashValue();
+                hv->sym = kp.sym;
                 hv->cont = NULL;
                 (void) memcpy((void*) hv->hashkey, (void*) & (kp.hashkey),
                               MD5_LEN);
                 HASH_ADD(hh, transtable, hashkey, MD5_LEN, hv);
                 hash_added++;
+                stats.tt_stores++;
+                checkpointEntry(m, &kp, NULL);
             }
 
             break;
         } else {
-            if (ishash == true) {
+            if ((ishash == true) && (aborted == false)
+                    && roomInTable()) {
                 HASHVALUE* hv = getHashValue();
+                hv->sym = kp.sym;
                 hv->cont = wml;
                 wml->use_count++;
                 (void) memcpy((void*) hv->hashkey, (void*) & (kp.hashkey),
                               MD5_LEN);
                 HASH_ADD(hh, transtable, hashkey, MD5_LEN, hv);
                 hash_added++;
+                stats.tt_stores++;
+                checkpointEntry(m, &kp, wml);
             }
 
             minStip = (mateIn < minStip) ? mateIn : minStip;
@@ -726,7 +961,7 @@ static BOARDLIST* norm_blackMidMove(BOARD* inBrd, int move)
             m->nextply = wml;
         }
 
-        if (opt_classify == false) {
+        if (keep_positions == false) {
             freePosition(m->pos);
             m->pos = NULL;
         }
@@ -810,19 +1045,10 @@ static BOARDLIST* blackMove(BOARD* inBrd)
     }
 
     DL_FOREACH(bml->vektor, b) {
-#ifdef MOVESTAT
-        {
-            char* stf = toSquare(b->from);
-            char* stt = toSquare(b->to);
-            (void) fprintf(stderr,
-            "   1...%c%s-%s (added = %u, hit null = %u, hit_list = %u)\n",
-            toPiece(b->mover), stf, stt, hash_added,
-            hash_hit_null, hash_hit_list);
-            (void) fflush(stderr);
-            free(stf);
-            free(stt);
-        }
-#endif
+        if (outOfResources(b) == true) {
+            break;
+        }
+
         qualifyMove(bml, b);
 
         if (opt_moves == 2) {
@@ -837,6 +1063,10 @@ static BOARDLIST* blackMove(BOARD* inBrd)
             refuts++;
             freeBoardlist(wml);
 
+            if (b->killer == true) {
+                stats.killer_hits++;
+            }
+
             if ((b->mover != KING) && (b->check != true)
                     && (b->flights == 0)
                     && (b->captured == false)) {
@@ -866,7 +1096,7 @@ static BOARDLIST* blackMove(BOARD* inBrd)
             minStip = (mateIn < minStip) ? mateIn : minStip;
             maxStip = (mateIn > maxStip) ? mateIn : maxStip;
 
-            if (opt_classify == false) {
+            if (keep_positions == false) {
                 freePosition(b->pos);
                 b->pos = NULL;
             }
@@ -910,6 +1140,8 @@ static BOARDLIST* norm_final_move(BOARD* inBrd, int move)
 
     if (opt_aim == MATE) {
         DL_FOREACH_SAFE(wml->vektor, bd, tmp) {
+            countNode(bd);
+
             if (bd->check == true) {
                 bml = generateRefutations(bd, opt_moves);
                 assert(bml != NULL);
@@ -919,7 +1151,7 @@ static BOARDLIST* norm_final_move(BOARD* inBrd, int move)
                     stipAchieved = true;
                     bd->tag = '#';
 
-                    if (opt_classify == false) {
+                    if (keep_positions == false) {
                         freePosition(bd->pos);
                         bd->pos = NULL;
                     }
@@ -936,6 +1168,8 @@ static BOARDLIST* norm_final_move(BOARD* inBrd, int move)
         }
     } else {
         DL_FOREACH_SAFE(wml->vektor, bd, tmp) {
+            countNode(bd);
+
             if (bd->check == false) {
                 bml = generateRefutations(bd, opt_moves);
                 assert(bml != NULL);
@@ -945,7 +1179,7 @@ static BOARDLIST* norm_final_move(BOARD* inBrd, int move)
                     stipAchieved = true;
                     bd->tag = '=';
 
-                    if (opt_classify == false) {
+                    if (keep_positions == false) {
                         freePosition(bd->pos);
                         bd->pos = NULL;
                     }
@@ -994,10 +1228,11 @@ static BOARDLIST* gloss_first_move(BOARD* brd, int moves)
     int ct;
     wml = generateWhiteBoardlist(brd, 1);
     DL_FOREACH_SAFE(wml->vektor, b, tmp) {
-        if (stipAchieved == true) {
+        if ((stipAchieved == true) || (aborted == true)) {
             DL_DELETE(wml->vektor, b);
             freeBoard(b);
         } else {
+            countNode(b);
             bcheck = b->check;
             bml = gloss_blackMove(b, moves);
             assert(bml != NULL);
@@ -1057,28 +1292,63 @@ static BOARDLIST* norm_first_move(BOARD* brd)
     unsigned char maxStip = 0;
     bool stipAchieved = false;
     int ct;
+    unsigned int ix = 0;
+    unsigned int keys = 0;
+    // Once more keys than --sols are found the problem is cooked whatever
+    // the other moves do, so they are only needed for the tries, or for
+    // merging the shards.
+    bool cutoff = (opt_tries == false) && (opt_shards == 0);
     wml = generateWhiteBoardlist(brd, 1);
+    unresolved = getBoardlist(WHITE, 1);
+    first_moves = wml;
     DL_FOREACH_SAFE(wml->vektor, b, tmp) {
-#ifdef MOVESTAT
-        {
-            char* from = toSquare(b->from);
-            char* to = toSquare(b->to);
-
-            (void) fprintf(stderr,
-            "1.%c%s-%s (added = %u, hit_null = %u, hit_list = %u)\n",
-            toPiece(b->mover), from, to, hash_added, hash_hit_null,
-            hash_hit_list);
-            (void) fflush(stderr);
-            free(from);
-            free(to);
-        }
-#endif
-        bml = blackMove(b);
+        if ((opt_shards != 0) && ((ix++ % opt_shards) != (opt_shard - 1))) {
+            // Another shard's move
+            DL_DELETE(wml->vektor, b);
+            freeBoard(b);
+            continue;
+        }
+
+        if ((cutoff == true) && (keys > opt_sols)) {
+            // Already cooked, so not searched
+            DL_DELETE(wml->vektor, b);
+
+            if (opt_quick == true) {
+                freeBoard(b);
+            } else {
+                DL_APPEND(unresolved->vektor, b);
+            }
+
+            continue;
+        }
+
+        if (aborted == true) {
+            // Not searched
+            DL_DELETE(wml->vektor, b);
+            DL_APPEND(unresolved->vektor, b);
+            continue;
+        }
+
+        countNode(b);
+
+        if (resumeFirstMove(b, &bml, &transtable, &killers) == false) {
+            bml = blackMove(b);
+
+            if (aborted == false) {
+                checkpointFirstMove(b, bml, killers);
+            }
+        }
+
         assert(bml != NULL);
         DL_COUNT(bml->vektor, tmp1, ct);
 
-        if ((ct == 0) && (opt_aim == MATE)
-                && (b->check == false)) {
+        if (aborted == true) {
+            // Search stopped before this move was resolved
+            freeBoardlist(bml);
+            DL_DELETE(wml->vektor, b);
+            DL_APPEND(unresolved->vektor, b);
+        } else if ((ct == 0) && (opt_aim == MATE)
+                   && (b->check == false)) {
             freeBoardlist(bml);
             DL_DELETE(wml->vektor, b);
             freeBoard(b);
@@ -1099,6 +1369,14 @@ static BOARDLIST* norm_first_move(BOARD* brd)
             b->tag = '?';
             putRefutsToEnd(bml);
             b->nextply = bml;
+
+            if ((opt_meson == true) && (keep_positions == false)
+                    && (opt_trivialtries == true)) {
+                // Nothing else looks at the try's variations, so they go now.
+                trimTry(b);
+            }
+
+            dropPosition(b);
             minStip = (bml->stipIn < minStip) ? bml->stipIn : minStip;
             maxStip = (bml->stipIn > maxStip) ? bml->stipIn : maxStip;
             /*
@@ -1114,9 +1392,19 @@ static BOARDLIST* norm_first_move(BOARD* brd)
         } else {
             stipAchieved = true;
             b->tag = '!';
+            keys++;
             b->nextply = bml;
             minStip = (bml->stipIn < minStip) ? bml->stipIn : minStip;
             maxStip = (bml->stipIn > maxStip) ? bml->stipIn : maxStip;
+
+            if (opt_quick == true) {
+                // Only the key itself counts
+                freeBoardlist(bml);
+                b->nextply = NULL;
+            }
+
+            dropPosition(b);
+
             /*
                      if ( opt_threats != NONE ) {
                         state = THREATS;
@@ -1146,89 +1434,106 @@ static BOARDLIST* norm_first_move(BOARD* brd)
         wml->stipIn = NOSTIP;
     }
 
+    if (unresolved->vektor != NULL) {
+        BOARD* nb;
+        BOARDLIST* uml = generateWhiteBoardlist(brd, 1);
+        DL_FOREACH(unresolved->vektor, nb) {
+            qualifyMove(uml, nb);
+        }
+        freeBoardlist(uml);
+    }
+
     return wml;
 }
 
-static void weedNonDefences(BOARDLIST* threats, BOARDLIST* bbl, bool fleck)
+/*
+ * A small open-addressed set of threat fingerprints, so each continuation
+ * is looked up once rather than compared against every threat.
+ */
+static uint64_t* threatSet(BOARDLIST* threats, unsigned int* mask)
 {
-    BOARDLIST* wbl;
-    unsigned int c;
-    BOARD* bm;
+    uint64_t* set;
+    unsigned int size = 8;
     BOARD* tm;
-    BOARD* wm;
-    BOARD* tmp;
-    BOARD* tmp1;
-    assert(threats != NULL);
-    assert(bbl != NULL);
     int ct;
+    DL_COUNT(threats->vektor, tm, ct);
 
+    while (size < (unsigned int)(ct * 2)) {
+        size <<= 1;
+    }
 
-    if ((fleck == true) && (bbl->moveNumber == 1)) {
-        DL_FOREACH_SAFE(bbl->vektor, bm, tmp) {
-            if (bm->mover != KING) {
-#ifdef MOVESTAT
+    set = (uint64_t*) calloc(size, sizeof(uint64_t));
+    SENGINE_MEM_ASSERT(set);
+    *mask = size - 1;
+    DL_FOREACH(threats->vektor, tm) {
+        uint64_t fp = boardFingerprint(tm);
+        unsigned int i = (unsigned int) fp & *mask;
 
-                if (bbl->moveNumber == 1) {
-                    fprintf(stderr, "WeedNonDefences %d...\n", bbl->moveNumber);
-                }
+        while ((set[i] != 0) && (set[i] != fp)) {
+            i = (i + 1) & *mask;
+        }
 
-#endif
-                wbl = bm->nextply;
+        set[i] = fp;
+    }
+    return set;
+}
 
-                if (wbl != NULL) {
-                    c = 0;
-                    DL_FOREACH(threats->vektor, tm) {
-                        DL_FOREACH(wbl->vektor, wm) {
-                            if (deepEquals(wm, tm) == true) {
-                                c++;
-                            }
-                        }
-                    }
-                    DL_COUNT(threats->vektor, tmp1, ct);
+static bool inThreatSet(uint64_t* set, unsigned int mask, uint64_t fp)
+{
+    unsigned int i = (unsigned int) fp & mask;
 
-                    if (ct == c) {
-                        DL_DELETE(bbl->vektor, bm);
-                        freeBoard(bm);
-                    }
-                }
-            }
+    while (set[i] != 0) {
+        if (set[i] == fp) {
+            return true;
         }
-    } else {
-        DL_FOREACH_SAFE(bbl->vektor, bm, tmp) {
-            if (bm->mover != KING) {
-#ifdef MOVESTAT
-
-                fprintf(stderr, "%d... WeedNonDefences\n", bbl->moveNumber);
 
-#endif
-                wbl = bm->nextply;
+        i = (i + 1) & mask;
+    }
 
-                if (wbl != NULL) {
-                    c = 0;
-                    DL_FOREACH(threats->vektor, tm) {
-                        DL_FOREACH(wbl->vektor, wm) {
-                            if (deepEquals(wm, tm) == true) {
-#ifdef MOVESTAT
+    return false;
+}
 
-                                if (bbl->moveNumber == 1) {
-                                    fputs("TO_WEED\n", stderr);
-                                }
+static void weedNonDefences(BOARDLIST* threats, BOARDLIST* bbl, bool fleck)
+{
+    BOARDLIST* wbl;
+    unsigned int c;
+    unsigned int mask;
+    uint64_t* set;
+    BOARD* bm;
+    BOARD* wm;
+    BOARD* tmp;
+    BOARD* tmp1;
+    assert(threats != NULL);
+    assert(bbl != NULL);
+    int ct;
+    set = threatSet(threats, &mask);
+    DL_COUNT(threats->vektor, tmp1, ct);
+    DL_FOREACH_SAFE(bbl->vektor, bm, tmp) {
+        if (bm->mover != KING) {
+            wbl = bm->nextply;
 
-#endif
-                                c++;
-                            }
-                        }
+            if (wbl != NULL) {
+                c = 0;
+                DL_FOREACH(wbl->vektor, wm) {
+                    if (inThreatSet(set, mask, boardFingerprint(wm)) == true) {
+                        c++;
                     }
+                }
 
-                    if (c != 0) {
+                if ((fleck == true) && (bbl->moveNumber == 1)) {
+                    // Only a defence if it stops some of the threats
+                    if ((int) c == ct) {
                         DL_DELETE(bbl->vektor, bm);
                         freeBoard(bm);
                     }
+                } else if (c != 0) {
+                    DL_DELETE(bbl->vektor, bm);
+                    freeBoard(bm);
                 }
             }
         }
     }
-
+    free(set);
     return;
 }
 
@@ -1251,6 +1556,56 @@ static void walkBBoardList(BOARDLIST* bbl)
     return;
 }
 
+/*
+ * The threat from a white node is the white play after a black pass. The
+ * same position turns up again under other tries and defences, so each
+ * threat is searched (and its own threats walked) once and shared.
+ */
+static BOARDLIST* threatMove(BOARD* wb, int move)
+{
+    HASHVALUE* ptr;
+    BOARDLIST* tbl;
+    HASHKEY kp;
+    getHashKey(wb, 0, &kp);
+    HASH_FIND(hh, threattable, &kp, MD5_LEN, ptr);
+
+    if (ptr != NULL) {
+        if (ptr->sym == kp.sym) {
+            stats.threat_hits++;
+            ptr->cont->use_count++;
+            return ptr->cont;
+        }
+
+        tbl = mapList(ptr->cont, wb, ptr->sym, kp.sym);
+
+        if (tbl != NULL) {
+            stats.threat_hits++;
+            return tbl;
+        }
+    }
+
+    if ((move + 1) == opt_moves) {
+        tbl = norm_final_move(wb, opt_moves);
+    } else {
+        tbl = norm_whiteMidMove(wb, move + 1);
+        walkWBoardList(tbl);
+    }
+
+    assert(tbl != NULL);
+
+    if ((ptr == NULL) && (aborted == false) && roomInTable()) {
+        ptr = (HASHVALUE*) calloc(1, sizeof(HASHVALUE));
+        SENGINE_MEM_ASSERT(ptr);
+        ptr->sym = kp.sym;
+        ptr->cont = tbl;
+        tbl->use_count++;
+        (void) memcpy((void*) ptr->hashkey, (void*) & (kp.hashkey), MD5_LEN);
+        HASH_ADD(hh, threattable, hashkey, MD5_LEN, ptr);
+    }
+
+    return tbl;
+}
+
 static void walkWBoardList(BOARDLIST* wbl)
 {
     BOARDLIST* bbl;
@@ -1269,36 +1624,23 @@ static void walkWBoardList(BOARDLIST* wbl)
         if (bbl != NULL) {
             assert(bbl->legalMoves != 0);
 
-            if ((move + 1) == opt_moves) {
-                if ((check == false) && (bbl->legalMoves > 1)) {
-                    tbl = norm_final_move(wb, opt_moves);
-                    assert(tbl != NULL);
-                    DL_COUNT(tbl->vektor, tmp, ct);
+            if ((check == false) && (bbl->legalMoves > 1)) {
+                tbl = threatMove(wb, move);
 
-                    if (ct > 0) {
-                        wb->threat = tbl;
-                        weedNonDefences(tbl, bbl, opt_fleck);
-                    } else {
-                        freeBoardlist(tbl);
-                    }
-                }
-            } else {
-                if ((check == false) && (bbl->legalMoves > 1)) {
-                    tbl = norm_whiteMidMove(wb, move + 1);
-                    assert(tbl != NULL);
-                    walkWBoardList(tbl);
+                if ((move + 1) != opt_moves) {
                     walkBBoardList(bbl);
-                    DL_COUNT(tbl->vektor, tmp, ct);
+                }
 
-                    if (ct > 0) {
-                        wb->threat = tbl;
-                        weedNonDefences(tbl, bbl, opt_fleck);
-                    } else {
-                        freeBoardlist(tbl);
-                    }
+                DL_COUNT(tbl->vektor, tmp, ct);
+
+                if (ct > 0) {
+                    wb->threat = tbl;
+                    weedNonDefences(tbl, bbl, opt_fleck);
                 } else {
-                    walkBBoardList(bbl);
+                    freeBoardlist(tbl);
                 }
+            } else if ((move + 1) != opt_moves) {
+                walkBBoardList(bbl);
             }
         }
     }
@@ -1314,23 +1656,121 @@ static void calculateThreats(BOARDLIST* wbl)
 static void sortTriesKeys(DIR_SOL* ds)
 {
     BOARD* b;
-    BOARD* bc;
+    BOARD* tmp;
     BOARDLIST* g_keys = getBoardlist(WHITE, 1);
     BOARDLIST* g_tries = getBoardlist(WHITE, 1);
-    DL_FOREACH(ds->trieskeys->vektor, b) {
-        bc = cloneBoard(b);
+    DL_FOREACH_SAFE(ds->trieskeys->vektor, b, tmp) {
+        DL_DELETE(ds->trieskeys->vektor, b);
 
         if (isKey(b) == true) {
-            DL_APPEND(g_keys->vektor, bc);
+            DL_APPEND(g_keys->vektor, b);
         } else {
-            DL_APPEND(g_tries->vektor, bc);
+            DL_APPEND(g_tries->vektor, b);
         }
     }
+    freeBoardlist(ds->trieskeys);
+    ds->trieskeys = NULL;
     ds->tries = g_tries;
     ds->keys = g_keys;
     return;
 }
 
+/*
+ * --meson gives a try with just its threat and refutations, so the rest
+ * of its variations are dropped.
+ */
+static void trimTry(BOARD* wm)
+{
+    BOARD* bm;
+    BOARD* tmp;
+
+    if (wm->nextply != NULL) {
+        DL_FOREACH_SAFE(wm->nextply->vektor, bm, tmp) {
+            if (bm->tag != '!') {
+                DL_DELETE(wm->nextply->vektor, bm);
+                freeBoard(bm);
+            }
+        }
+    }
+
+    return;
+}
+
+/*
+ * Gives back what the tree holds that the output will not need, once the
+ * memory budget is nearly spent: positions kept for the classification,
+ * which is now skipped, and the variations of --meson tries. While the
+ * first moves are searched one may be in hand, so only those already
+ * searched are touched, and their tries are only trimmed if
+ * deTrivialise() will not count them.
+ */
+static void shedMemory(void)
+{
+    if (first_moves != NULL) {
+        shedTree(first_moves, true, (opt_meson == true) && (opt_trivialtries == true));
+    } else {
+        if (solution->tries != NULL) {
+            shedTree(solution->tries, false, opt_meson);
+        }
+
+        if (solution->keys != NULL) {
+            shedTree(solution->keys, false, false);
+        }
+    }
+
+    return;
+}
+
+static void shedTree(BOARDLIST* bl, bool busy, bool trim)
+{
+    BOARD* b;
+    DL_FOREACH(bl->vektor, b) {
+        if ((busy == true) && (b->nextply == NULL)) {
+            continue;
+        }
+
+        if ((trim == true) && (b->tag == '?')) {
+            trimTry(b);
+        }
+
+        if (b->threat != NULL) {
+            shedTree(b->threat, false, false);
+        }
+
+        if (b->nextply != NULL) {
+            shedTree(b->nextply, false, false);
+        }
+
+        dropPosition(b);
+    }
+    return;
+}
+
+/*
+ * Frees the position of a move kept in the tree once its replies are
+ * known. The classification needs them all, but otherwise only a white
+ * move with replies keeps it, for the threats to be looked for from.
+ */
+static void dropPosition(BOARD* b)
+{
+    if ((keep_positions == false) && (b->pos != NULL)
+            && ((b->side == BLACK) || (b->nextply == NULL) || (opt_threats == NONE))) {
+        freePosition(b->pos);
+        b->pos = NULL;
+    }
+
+    return;
+}
+
+/*
+ * As dropPosition, for the trees checkpoint.c restores in place of a search.
+ */
+void dropRestoredPosition(BOARD* b)
+{
+    dropPosition(b);
+    return;
+}
+
 static void deTrivialise(BOARDLIST* wml)
 {
     BOARDLIST* bml;
@@ -1365,6 +1805,10 @@ static BOARDLIST* calculateSetPlay(BOARD* inBrd)
     assert(inBrd != NULL);
     bList = generateBlackBoardlist(inBrd, 1, &flights);
     DL_FOREACH_SAFE(bList->vektor, ourBrd, tmp) {
+        if (outOfResources(ourBrd) == true) {
+            break;
+        }
+
         if (opt_moves > 2) {
             wList = norm_whiteMidMove(ourBrd, 2);
         } else {
@@ -1410,6 +1854,8 @@ static BOARDLIST* gloss_final_move(BOARD* inBrd, int moveno)
                 DL_DELETE(wml->vektor, bd);
                 freeBoard(bd);
             } else {
+                countNode(bd);
+
                 if (bd->check == true) {
                     bml = generateRefutations(bd, moveno);
                     assert(bml != NULL);
@@ -1420,7 +1866,7 @@ static BOARDLIST* gloss_final_move(BOARD* inBrd, int moveno)
                         stipAchieved = true;
                         bd->tag = '#';
 
-                        if (opt_classify == false) {
+                        if (keep_positions == false) {
                             freePosition(bd->pos);
                             bd->pos = NULL;
                         }
@@ -1440,6 +1886,8 @@ static BOARDLIST* gloss_final_move(BOARD* inBrd, int moveno)
                 DL_DELETE(wml->vektor, bd);
                 freeBoard(bd);
             } else {
+                countNode(bd);
+
                 if (bd->check == false) {
                     bml = generateRefutations(bd, moveno);
                     assert(bml != NULL);
@@ -1450,7 +1898,7 @@ static BOARDLIST* gloss_final_move(BOARD* inBrd, int moveno)
                         stipAchieved = true;
                         bd->tag = '=';
 
-                        if (opt_classify == false) {
+                        if (keep_positions == false) {
                             freePosition(bd->pos);
                             bd->pos = NULL;
                         }
@@ -1494,6 +1942,12 @@ static BOARDLIST* norm_whiteMidMove(BOARD* inBrd, int move)
     unsigned char maxStip = 0;
     unsigned char minStip = NOSTIP;
     assert(inBrd != NULL);
+    wml = earlyRefutation(inBrd, WHITE, move);
+
+    if (wml != NULL) {
+        return wml;
+    }
+
     wml = generateWhiteBoardlist(inBrd, move);
 
     if ((state != THREATS) || ((state == THREATS)
@@ -1509,8 +1963,7 @@ static BOARDLIST* norm_whiteMidMove(BOARD* inBrd, int move)
                     if (ct == 0) {
                         shortStipAchieved = true;
                         m->tag = '#';
-                        //freePosition( m->pos );
-                        //m->pos = NULL;
+                        dropPosition(m);
                     } else {
                         DL_DELETE(wml->vektor, m);
                         freeBoard(m);
@@ -1531,8 +1984,7 @@ static BOARDLIST* norm_whiteMidMove(BOARD* inBrd, int move)
                     if (ct == 0) {
                         shortStipAchieved = true;
                         m->tag = '=';
-                        //freePosition( m->pos );
-                        //m->pos = NULL;
+                        dropPosition(m);
                     } else {
                         DL_DELETE(wml->vektor, m);
                         freeBoard(m);
@@ -1566,7 +2018,8 @@ static BOARDLIST* norm_whiteMidMove(BOARD* inBrd, int move)
     }
 
     DL_FOREACH_SAFE(wml->vektor, m, tmp) {
-        if ((state != THREATS) && (shortStipAchieved == true)) {
+        if (((state != THREATS) && (shortStipAchieved == true))
+                || (outOfResources(m) == true)) {
             DL_DELETE(wml->vektor, m);
             freeBoard(m);
         } else {
@@ -1591,6 +2044,7 @@ static BOARDLIST* norm_whiteMidMove(BOARD* inBrd, int move)
             } else {
                 stipAchieved = true;
                 m->nextply = bml;
+                dropPosition(m);
                 maxStip = (bml->stipIn > maxStip) ? bml->stipIn : maxStip;
                 minStip = (bml->stipIn < minStip) ? bml->stipIn : minStip;
 
@@ -1627,3 +2081,139 @@ static BOARDLIST* norm_whiteMidMove(BOARD* inBrd, int move)
 
     return wml;
 }
+
+static void evictTransTable(void)
+{
+    HASHVALUE* cu;
+    HASHVALUE* tmp;
+    HASH_ITER(hh, transtable, cu, tmp) {
+        HASH_DEL(transtable, cu);
+        stats.tt_replacements++;
+
+        if (cu->cont != NULL) {
+            freeBoardlist(cu->cont);
+        }
+
+        freeHashValue(cu);
+    }
+    checkpointEvicted();
+    return;
+}
+
+static void countNode(BOARD* b)
+{
+    stats.nodes[b->side][(b->ply < STATS_PLIES) ? b->ply : STATS_PLIES - 1]++;
+    return;
+}
+
+/*
+ * An empty, refuted list for toPlay's replies at move to b when White
+ * cannot mate from there in the moves left, else NULL. The search would
+ * have found the same after searching it all. A tablebase answers for
+ * small material, and --intelligent bounds the moves a mate takes.
+ * Shorter problems do not repay building the tables.
+ */
+static BOARDLIST* earlyRefutation(BOARD* b, enum COLOUR toPlay, int move)
+{
+    BOARDLIST* bl;
+    int left = (toPlay == WHITE) ? opt_moves - move + 1 : opt_moves - move;
+    int dtm;
+
+    if (opt_aim != MATE) {
+        return NULL;
+    }
+
+    if ((opt_intelligent == true)
+            && (intel_unreachable(b->pos, left, (toPlay == WHITE) ? left - 1 : left) == true)) {
+        stats.intel_cutoffs++;
+    } else {
+        if (opt_moves < 4) {
+            return NULL;
+        }
+
+        dtm = tb_probe(b->pos, toPlay);
+
+        if ((dtm < 0) || (dtm <= left)) {
+            return NULL;
+        }
+
+        stats.tb_cutoffs++;
+    }
+
+    bl = getBoardlist(toPlay, (unsigned char) move);
+    bl->minStip = NOSTIP;
+    bl->maxStip = NOSTIP;
+    bl->stipIn = NOSTIP;
+    return bl;
+}
+
+static double elapsed(void)
+{
+    struct timespec now;
+    (void) clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - search_start.tv_sec)
+           + (double)(now.tv_nsec - search_start.tv_nsec) / 1e9;
+}
+
+/*
+ * Whether a transposition table entry may be stored. An entry not stored
+ * can change which variations are found, so the result is degraded.
+ */
+static bool roomInTable(void)
+{
+    if (memoryPressure() == MEM_OK) {
+        return true;
+    }
+
+    squeezed = true;
+    return false;
+}
+
+static bool outOfResources(BOARD* b)
+{
+    enum MEMSTATE ms;
+    countNode(b);
+
+    if (aborted == false) {
+        nodes++;
+
+        if ((opt_nodelimit != 0) && (nodes > opt_nodelimit)) {
+            aborted = true;
+            stop_reason = TIMEOUT;
+            return aborted;
+        }
+
+        if ((opt_timelimit != 0) && ((nodes & 0x3ff) == 0) && (elapsed() >= opt_timelimit)) {
+            aborted = true;
+            stop_reason = TIMEOUT;
+            return aborted;
+        }
+
+        ms = memoryPressure();
+
+        if (ms != MEM_OK) {
+            squeezed = true;
+
+            // First the transposition table goes ...
+            if (transtable != NULL) {
+                evictTransTable();
+            }
+
+            // ... then positions kept only for classification, and the
+            // variations that will not be written ...
+            if ((ms >= MEM_DROP) && (shed == false)) {
+                shed = true;
+                keep_positions = false;
+                shedMemory();
+            }
+
+            // ... and finally the search itself.
+            if (ms == MEM_EXHAUSTED) {
+                aborted = true;
+                stop_reason = RESOURCE_LIMIT;
+            }
+        }
+    }
+
+    return aborted;
+}
@@ -0,0 +1,655 @@
+/*
+ *	help.c
+ *	(c) 2020, Brian Stephenson
+ *	brian@bstephen.me.uk
+ *
+ *	A program to test orthodox chess problems of the types:
+ *
+ *		directmates
+ *		selfmates
+ *		relfexmates
+ *		helpmates
+ *
+ *	Input is taken from the program options and output is xml on stdout.
+ *
+ *	This is the module for solving helpmates and helpstalemates. Black
+ *	plays first and both sides work together, so every line of play that
+ *	ends in mate (or stalemate) on White's last move is a solution.
+ *
+ *	Black's first moves are shared out between search threads, each with
+ *	its own pools and transposition table. The table holds the positions
+ *	that no helpmate can be played from, keyed by the half-moves left.
+ *	A thread only records the moves of each line it finds; the solution
+ *	tree is built afterwards from those, so every board in it belongs to
+ *	the main thread.
+ */
+
+#include "sengine.h"
+#include <pthread.h>
+#include <unistd.h>
+
+#define HELP_MAX_HALF 18
+#define HELP_MAX_THREADS 64
+
+extern enum AIM opt_aim;
+extern unsigned int opt_moves;
+extern unsigned int opt_sols;
+extern bool opt_actual;
+extern bool opt_threads;
+extern bool opt_intelligent;
+extern bool opt_mitm;
+extern int opt_hash;
+extern enum SOUNDNESS sound;
+
+void setup_mpool();
+void destroy_mpool();
+void freeHashValue(HASHVALUE*);
+BOARDLIST* generateRefutations(BOARD*, int);
+void qualifyMove(BOARDLIST*, BOARD*);
+
+typedef struct HELP_MOVE {
+    unsigned char from;
+    unsigned char to;
+    unsigned char promotion;
+} HELP_MOVE;
+
+/*
+ * The lines found under one of Black's first moves, end to end.
+ */
+typedef struct HELP_LINES {
+    HELP_MOVE* moves;
+    unsigned int count;
+    unsigned int size;
+} HELP_LINES;
+
+/*
+ * A position half way through, with the lines that reach it and those
+ * that go on from it to the goal. The key is zeroed before it is filled,
+ * so that it can be compared as bytes.
+ */
+typedef struct HELP_MIDDLE {
+    struct {
+        POSITION pos;
+        unsigned char epSquare;
+    } key;
+    bool check;
+    HELP_LINES before;
+    HELP_LINES after;
+    UT_hash_handle hh;
+} HELP_MIDDLE;
+
+typedef struct HELP_WORKER {
+    pthread_t thread;
+    HELP_MOVE path[HELP_MAX_HALF];
+    HELP_LINES* lines;           /* Of the first move being searched. */
+    HASHVALUE* transtable;
+    unsigned int tt_size;
+    unsigned int hash_added;
+    unsigned int hash_hit_null;
+} HELP_WORKER;
+
+static BOARD** roots = NULL;
+static HELP_LINES* found = NULL;
+static unsigned int root_count = 0;
+static unsigned int next_root = 0;
+static int half_moves = 0;
+static int mid_half = 0;
+static HELP_MIDDLE* middle_table = NULL;
+static HELP_MIDDLE** middles = NULL;
+static unsigned int middle_count = 0;
+static HELP_MOVE prefix[HELP_MAX_HALF];
+static HELP_LINES joined;
+static STATS* totals = NULL;
+static pthread_mutex_t help_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void countNode(BOARD* b)
+{
+    stats.nodes[b->side][(b->ply < STATS_PLIES) ? b->ply : STATS_PLIES - 1]++;
+    return;
+}
+
+static bool isGoal(BOARD* b, int move)
+{
+    BOARDLIST* bbl;
+    BOARD* tmp;
+    int ct;
+
+    if (b->check != (opt_aim == MATE)) {
+        return false;
+    }
+
+    bbl = generateRefutations(b, move);
+    DL_COUNT(bbl->vektor, tmp, ct);
+    freeBoardlist(bbl);
+    return ct == 0;
+}
+
+static void setMove(HELP_MOVE* hm, BOARD* b)
+{
+    hm->from = b->from;
+    hm->to = b->to;
+    hm->promotion = (unsigned char) b->promotion;
+    return;
+}
+
+static void addLine(HELP_LINES* hl, const HELP_MOVE* line)
+{
+    if (hl->count == hl->size) {
+        hl->size = (hl->size == 0) ? 4 : hl->size * 2;
+        hl->moves = (HELP_MOVE*) realloc(hl->moves,
+                                         hl->size * half_moves * sizeof(HELP_MOVE));
+        SENGINE_MEM_ASSERT(hl->moves);
+    }
+
+    (void) memcpy(&hl->moves[hl->count * half_moves], line,
+                  half_moves * sizeof(HELP_MOVE));
+    hl->count++;
+    return;
+}
+
+static void clearTransTable(HELP_WORKER* w)
+{
+    HASHVALUE* cu;
+    HASHVALUE* tmp;
+    HASH_ITER(hh, w->transtable, cu, tmp) {
+        HASH_DEL(w->transtable, cu);
+        freeHashValue(cu);
+    }
+    w->tt_size = 0;
+    return;
+}
+
+/*
+ * Plays every move of half-move half from brd, the first being 1, and
+ * returns the number of solutions found below them.
+ */
+static unsigned int helpSearch(HELP_WORKER* w, BOARD* brd, int half)
+{
+    BOARDLIST* bl;
+    BOARD* b;
+    HASHKEY kp;
+    unsigned int flights;
+    unsigned int sols = 0;
+    int move = (half + 1) / 2;
+    int left = half_moves - half + 1;
+    bool ishash = (left >= 2) && (brd->epSquare == 0);
+
+    // Black's moves left come before White's last one.
+    if ((opt_intelligent == true) && (opt_aim == MATE)
+            && (intel_unreachable(brd->pos, (left + 1) / 2, left / 2) == true)) {
+        stats.intel_cutoffs++;
+        return 0;
+    }
+
+    if (ishash == true) {
+        HASHVALUE* ptr;
+        getHashKey(brd, (unsigned char) left, &kp);
+        HASH_FIND(hh, w->transtable, &kp, MD5_LEN, ptr);
+        stats.tt_probes++;
+
+        if (ptr != NULL) {
+            stats.tt_hits++;
+            w->hash_hit_null++;
+            return 0;
+        }
+    }
+
+    if ((half & 1) == 1) {
+        bl = generateBlackBoardlist(brd, move, &flights);
+    } else {
+        bl = generateWhiteBoardlist(brd, move);
+    }
+
+    DL_FOREACH(bl->vektor, b) {
+        countNode(b);
+        setMove(&w->path[half - 1], b);
+
+        if (left == 1) {
+            if (isGoal(b, move) == true) {
+                addLine(w->lines, w->path);
+                sols++;
+            }
+        } else {
+            sols += helpSearch(w, b, half + 1);
+        }
+    }
+    freeBoardlist(bl);
+
+    if ((ishash == true) && (sols == 0) && (memoryPressure() == MEM_OK)) {
+        HASHVALUE* hv;
+
+        // A full table is emptied, as the directmate search does.
+        if (w->tt_size >= (unsigned int) opt_hash) {
+            stats.tt_replacements += w->tt_size;
+            clearTransTable(w);
+        }
+
+        hv = getHashValue();
+        hv->sym = kp.sym;
+        hv->cont = NULL;
+        (void) memcpy((void*) hv->hashkey, (void*) & (kp.hashkey), MD5_LEN);
+        HASH_ADD(hh, w->transtable, hashkey, MD5_LEN, hv);
+        w->tt_size++;
+        w->hash_added++;
+        stats.tt_stores++;
+    }
+
+    return sols;
+}
+
+static void addStats(STATS* to, const STATS* from)
+{
+    int c;
+    int p;
+
+    for (c = 0; c < 2; c++) {
+        for (p = 0; p < STATS_PLIES; p++) {
+            to->nodes[c][p] += from->nodes[c][p];
+        }
+    }
+
+    to->moves_generated += from->moves_generated;
+    to->attacks_calls += from->attacks_calls;
+    to->mate_tests += from->mate_tests;
+    to->tt_probes += from->tt_probes;
+    to->tt_hits += from->tt_hits;
+    to->tt_stores += from->tt_stores;
+    to->tt_replacements += from->tt_replacements;
+    to->intel_cutoffs += from->intel_cutoffs;
+    // The threads' pools were all live together.
+    to->board_peak += from->board_peak;
+    to->position_peak += from->position_peak;
+    to->boardlist_peak += from->boardlist_peak;
+    to->hashvalue_peak += from->hashvalue_peak;
+    to->mem_peak += from->mem_peak;
+    return;
+}
+
+static void* helpWorker(void* arg)
+{
+    HELP_WORKER* w = (HELP_WORKER*) arg;
+    init_mem();
+    setup_mpool();
+
+    for (;;) {
+        unsigned int i;
+        (void) pthread_mutex_lock(&help_lock);
+        i = next_root++;
+        (void) pthread_mutex_unlock(&help_lock);
+
+        if (i >= root_count) {
+            break;
+        }
+
+        if (middles != NULL) {
+            HELP_MIDDLE* m = middles[i];
+            BOARD* b = getBoard(&m->key.pos, (mid_half & 1) ? BLACK : WHITE,
+                                (unsigned char)((mid_half + 1) / 2));
+            b->epSquare = m->key.epSquare;
+            b->check = m->check;
+            w->lines = &m->after;
+            (void) helpSearch(w, b, mid_half + 1);
+            freeBoard(b);
+        } else {
+            // The first move itself is the main thread's and is only read.
+            w->lines = &found[i];
+            setMove(&w->path[0], roots[i]);
+            (void) helpSearch(w, roots[i], 2);
+        }
+    }
+
+    clearTransTable(w);
+    destroy_mpool();
+    close_mem();
+    (void) pthread_mutex_lock(&help_lock);
+    addStats(totals, &stats);
+    (void) pthread_mutex_unlock(&help_lock);
+    return NULL;
+}
+
+static unsigned int threadCount(void)
+{
+    long n = 1;
+
+    if (opt_threads == true) {
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+        n = (n < 1) ? 1 : ((n > HELP_MAX_THREADS) ? HELP_MAX_THREADS : n);
+    }
+
+    return ((unsigned int) n < root_count) ? (unsigned int) n : root_count;
+}
+
+/*
+ * Runs the threads over the root_count jobs, roots or middles.
+ */
+static void runWorkers(HELP_SOL* hsol)
+{
+    HELP_WORKER* workers;
+    unsigned int threads = threadCount();
+    unsigned int i;
+    next_root = 0;
+    workers = (HELP_WORKER*) calloc(threads + 1, sizeof(HELP_WORKER));
+    SENGINE_MEM_ASSERT(workers);
+    totals = &stats;
+
+    for (i = 0; i < threads; i++) {
+        if (pthread_create(&workers[i].thread, NULL, helpWorker, &workers[i]) != 0) {
+            (void) fputs("sengine ERROR: cannot start a search thread\n", stderr);
+            exit(1);
+        }
+    }
+
+    for (i = 0; i < threads; i++) {
+        (void) pthread_join(workers[i].thread, NULL);
+        hsol->hash_added += workers[i].hash_added;
+        hsol->hash_hit_null += workers[i].hash_hit_null;
+    }
+
+    free(workers);
+    return;
+}
+
+/*
+ * Searches the second half from every middle in the table, joins each
+ * line found to each line reaching the middle and empties the table.
+ */
+static void solveMiddles(HELP_SOL* hsol)
+{
+    HELP_MIDDLE* m;
+    HELP_MIDDLE* tmp;
+    HELP_MOVE line[HELP_MAX_HALF];
+    unsigned int i = 0;
+
+    if (middle_count == 0) {
+        return;
+    }
+
+    middles = (HELP_MIDDLE**) malloc(middle_count * sizeof(HELP_MIDDLE*));
+    SENGINE_MEM_ASSERT(middles);
+    HASH_ITER(hh, middle_table, m, tmp) {
+        middles[i++] = m;
+    }
+    root_count = middle_count;
+    runWorkers(hsol);
+    HASH_ITER(hh, middle_table, m, tmp) {
+        unsigned int a;
+        unsigned int b;
+
+        for (b = 0; b < m->before.count; b++) {
+            for (a = 0; a < m->after.count; a++) {
+                (void) memcpy(line, &m->before.moves[b * half_moves],
+                              mid_half * sizeof(HELP_MOVE));
+                (void) memcpy(&line[mid_half],
+                              &m->after.moves[a * half_moves + mid_half],
+                              (half_moves - mid_half) * sizeof(HELP_MOVE));
+                addLine(&joined, line);
+            }
+        }
+
+        HASH_DEL(middle_table, m);
+        free(m->before.moves);
+        free(m->after.moves);
+        free(m);
+    }
+    free(middles);
+    middles = NULL;
+    middle_count = 0;
+    return;
+}
+
+/*
+ * Files brd, reached by the line in prefix, under its position.
+ */
+static void addMiddle(HELP_SOL* hsol, BOARD* brd)
+{
+    HELP_MIDDLE* m = (HELP_MIDDLE*) calloc(1, sizeof(HELP_MIDDLE));
+    HELP_MIDDLE* ptr;
+    SENGINE_MEM_ASSERT(m);
+    (void) memcpy(m->key.pos.bitBoard, brd->pos->bitBoard,
+                  sizeof(brd->pos->bitBoard));
+    m->key.pos.kingsq[WHITE] = brd->pos->kingsq[WHITE];
+    m->key.pos.kingsq[BLACK] = brd->pos->kingsq[BLACK];
+    m->key.pos.flags = brd->pos->flags;
+    m->key.epSquare = brd->epSquare;
+    HASH_FIND(hh, middle_table, &m->key, sizeof(m->key), ptr);
+    stats.tt_probes++;
+
+    if (ptr != NULL) {
+        stats.tt_hits++;
+        free(m);
+        m = ptr;
+    } else {
+        if ((middle_count >= (unsigned int) opt_hash)
+                || (memoryPressure() != MEM_OK)) {
+            solveMiddles(hsol);
+        }
+
+        m->check = brd->check;
+        HASH_ADD(hh, middle_table, key, sizeof(m->key), m);
+        middle_count++;
+        stats.tt_stores++;
+    }
+
+    addLine(&m->before, prefix);
+    return;
+}
+
+/*
+ * Plays the first half of the moves on from brd, reached by half - 1
+ * half-moves, filing each position at the end of it.
+ */
+static void playFirstHalf(HELP_SOL* hsol, BOARD* brd, int half)
+{
+    BOARDLIST* bl;
+    BOARD* b;
+    unsigned int flights;
+    int move = (half + 1) / 2;
+    int left = half_moves - half + 1;
+
+    if (half > mid_half) {
+        addMiddle(hsol, brd);
+        return;
+    }
+
+    if ((opt_intelligent == true) && (opt_aim == MATE)
+            && (intel_unreachable(brd->pos, (left + 1) / 2, left / 2) == true)) {
+        stats.intel_cutoffs++;
+        return;
+    }
+
+    if ((half & 1) == 1) {
+        bl = generateBlackBoardlist(brd, move, &flights);
+    } else {
+        bl = generateWhiteBoardlist(brd, move);
+    }
+
+    DL_FOREACH(bl->vektor, b) {
+        countNode(b);
+        setMove(&prefix[half - 1], b);
+        playFirstHalf(hsol, b, half + 1);
+    }
+    freeBoardlist(bl);
+    return;
+}
+
+static bool sameMove(BOARD* b, HELP_MOVE* hm)
+{
+    return (b->from == hm->from) && (b->to == hm->to)
+           && ((unsigned char) b->promotion == hm->promotion);
+}
+
+/*
+ * Replaces the moves of bl with those played at half-move half in any of
+ * the count lines, each given the continuations of the lines through it.
+ */
+static void keepLines(BOARDLIST* bl, HELP_MOVE* lines, unsigned int count,
+                      int half)
+{
+    BOARD* b;
+    BOARD* tmp;
+    HELP_MOVE* sub = (HELP_MOVE*) malloc(count * half_moves * sizeof(HELP_MOVE));
+    SENGINE_MEM_ASSERT(sub);
+    DL_FOREACH(bl->vektor, b) {
+        qualifyMove(bl, b);
+    }
+    DL_FOREACH_SAFE(bl->vektor, b, tmp) {
+        unsigned int n = 0;
+        unsigned int i;
+
+        for (i = 0; i < count; i++) {
+            if (sameMove(b, &lines[i * half_moves + half - 1]) == true) {
+                (void) memcpy(&sub[n++ * half_moves], &lines[i * half_moves],
+                              half_moves * sizeof(HELP_MOVE));
+            }
+        }
+
+        if (n == 0) {
+            DL_DELETE(bl->vektor, b);
+            freeBoard(b);
+        } else if (half == half_moves) {
+            b->tag = (opt_aim == MATE) ? '#' : '=';
+        } else {
+            unsigned int flights;
+            int move = (half + 2) / 2;
+
+            if ((half & 1) == 1) {
+                b->nextply = generateWhiteBoardlist(b, move);
+            } else {
+                b->nextply = generateBlackBoardlist(b, move, &flights);
+            }
+
+            keepLines(b->nextply, sub, n, half + 1);
+        }
+    }
+    free(sub);
+    return;
+}
+
+/*
+ * All the helpmates in moves from startpos, or NULL if there are none.
+ * *count is set to the number of them.
+ */
+static BOARDLIST* helpSolutions(HELP_SOL* hsol, BOARD* startpos,
+                                unsigned int moves, unsigned int* count)
+{
+    BOARDLIST* bml;
+    BOARD* b;
+    HELP_MOVE* lines;
+    unsigned int flights;
+    unsigned int i;
+    unsigned int n = 0;
+    half_moves = 2 * (int) moves;
+    *count = 0;
+
+    // Also readies --intelligent's tables before any thread needs them.
+    if ((opt_intelligent == true) && (opt_aim == MATE)
+            && (intel_unreachable(startpos->pos, moves, moves) == true)) {
+        stats.intel_cutoffs++;
+        return NULL;
+    }
+
+    bml = generateBlackBoardlist(startpos, 1, &flights);
+
+    if (opt_mitm == true) {
+        mid_half = half_moves / 2;
+        DL_FOREACH(bml->vektor, b) {
+            countNode(b);
+            setMove(&prefix[0], b);
+            playFirstHalf(hsol, b, 2);
+        }
+        solveMiddles(hsol);
+        lines = joined.moves;
+        n = joined.count;
+        (void) memset(&joined, 0, sizeof(HELP_LINES));
+    } else {
+        DL_COUNT(bml->vektor, b, i);
+        root_count = i;
+        roots = (BOARD**) malloc((root_count + 1) * sizeof(BOARD*));
+        found = (HELP_LINES*) calloc(root_count + 1, sizeof(HELP_LINES));
+        SENGINE_MEM_ASSERT(roots);
+        SENGINE_MEM_ASSERT(found);
+        i = 0;
+        DL_FOREACH(bml->vektor, b) {
+            countNode(b);
+            roots[i++] = b;
+        }
+        runWorkers(hsol);
+
+        for (i = 0; i < root_count; i++) {
+            n += found[i].count;
+        }
+
+        lines = (HELP_MOVE*) malloc((n + 1) * half_moves * sizeof(HELP_MOVE));
+        SENGINE_MEM_ASSERT(lines);
+        n = 0;
+
+        // In the order of Black's first moves, whichever thread found them.
+        for (i = 0; i < root_count; i++) {
+            if (found[i].count > 0) {
+                (void) memcpy(&lines[n * half_moves], found[i].moves,
+                              found[i].count * half_moves * sizeof(HELP_MOVE));
+                n += found[i].count;
+            }
+
+            free(found[i].moves);
+        }
+
+        free(found);
+        free(roots);
+        found = NULL;
+        roots = NULL;
+    }
+
+    if (n > 0) {
+        keepLines(bml, lines, n, 1);
+    } else {
+        freeBoardlist(bml);
+        bml = NULL;
+    }
+
+    free(lines);
+    *count = n;
+    return bml;
+}
+
+void solve_help(HELP_SOL* hsol, BOARD* startpos)
+{
+    unsigned int count = 0;
+    unsigned int m;
+    sound = UNSET;
+
+    if (opt_actual == true) {
+        start_phase(PH_GLOSS);
+
+        for (m = 1; (m < opt_moves) && (hsol->sols == NULL); m++) {
+            hsol->sols = helpSolutions(hsol, startpos, m, &count);
+        }
+
+        end_phase(PH_GLOSS);
+
+        if (hsol->sols != NULL) {
+            sound = SHORT_SOLUTION;
+            return;
+        }
+    }
+
+    start_phase(PH_TRIESKEYS);
+    hsol->sols = helpSolutions(hsol, startpos, opt_moves, &count);
+    end_phase(PH_TRIESKEYS);
+
+    if (hsol->sols == NULL) {
+        hsol->sols = getBoardlist(BLACK, 1);
+    }
+
+    if (count == 0) {
+        sound = NO_SOLUTION;
+    } else if (count < opt_sols) {
+        sound = MISSING_SOLUTION;
+    } else if (count == opt_sols) {
+        sound = SOUND;
+    } else {
+        sound = COOKED;
+    }
+
+    return;
+}
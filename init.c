@@ -38,6 +38,7 @@ uint64_t hash_hit;
 uint64_t board_del;
 uint64_t boardlist_del;
 uint64_t position_del;
+__thread STATS stats;
 
 //kvec_t( POSITION * ) pos_pool;
 
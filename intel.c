@@ -0,0 +1,376 @@
+/*
+ *	intel.c
+ *	(c) 2020, Brian Stephenson
+ *	brian@bstephen.me.uk
+ *
+ *	A program to test orthodox chess problems of the types:
+ *
+ *		directmates
+ *		selfmates
+ *		relfexmates
+ *		helpmates
+ *
+ *	Input is taken from the program options and output is xml on stdout.
+ *
+ *	This is the module for --intelligent. A mate needs a final square for
+ *	the black king, a white man checking it there and each of its flights
+ *	covered by White or blocked by Black. Candidate mates are enumerated
+ *	over the squares the black king can reach in the moves left, and each
+ *	is priced with lower bounds on the moves the men need to get into
+ *	place: empty board distances, which pieces in the way only lengthen,
+ *	and for a pawn no more than its way to promotion.
+ *
+ *	When no candidate can be reached even with both sides helping, no
+ *	play can mate in time, so the search can drop the position unsearched.
+ */
+
+#include "sengine.h"
+
+#define INTEL_FAR 64
+
+extern BITBOARD setMask[64];
+extern BITBOARD king_attacks[64];
+extern BITBOARD knight_attacks[64];
+extern BITBOARD bishop_attacks[64];
+extern BITBOARD rook_attacks[64];
+
+int tzcount(BITBOARD inBrd);
+
+/*
+ * By piece and on an empty board: the moves from one square to another,
+ * to a square attacking a second and to one attacking or on a second.
+ */
+static unsigned char dist[KING + 1][64][64];
+static unsigned char checkCost[KING + 1][64][64];
+static unsigned char coverCost[KING + 1][64][64];
+static bool ready = false;
+
+static BITBOARD emptyAttacks(enum PIECE piece, int sq)
+{
+    switch (piece) {
+    case KNIGHT:
+        return knight_attacks[sq];
+
+    case BISHOP:
+        return bishop_attacks[sq];
+
+    case ROOK:
+        return rook_attacks[sq];
+
+    case QUEEN:
+        return bishop_attacks[sq] | rook_attacks[sq];
+
+    default:
+        return king_attacks[sq];
+    }
+}
+
+static void setup(void)
+{
+    enum PIECE piece;
+    int from;
+    int to;
+
+    for (piece = KNIGHT; piece <= KING; piece++) {
+        for (from = 0; from < 64; from++) {
+            BITBOARD seen = setMask[from];
+            BITBOARD ring = setMask[from];
+            unsigned char d = 0;
+            (void) memset(dist[piece][from], INTEL_FAR, 64);
+
+            while (ring != 0) {
+                BITBOARD next = 0;
+
+                while (ring != 0) {
+                    int sq = tzcount(ring);
+                    ring &= ring - 1;
+                    dist[piece][from][sq] = d;
+                    next |= emptyAttacks(piece, sq);
+                }
+
+                ring = next & ~seen;
+                seen |= next;
+                d++;
+            }
+        }
+
+        for (from = 0; from < 64; from++) {
+            for (to = 0; to < 64; to++) {
+                BITBOARD at = emptyAttacks(piece, to);
+                unsigned char best = INTEL_FAR;
+
+                while (at != 0) {
+                    int sq = tzcount(at);
+                    at &= at - 1;
+
+                    if (dist[piece][from][sq] < best) {
+                        best = dist[piece][from][sq];
+                    }
+                }
+
+                checkCost[piece][from][to] = best;
+                coverCost[piece][from][to] =
+                    (dist[piece][from][to] < best) ? dist[piece][from][to] : best;
+            }
+        }
+    }
+
+    ready = true;
+    return;
+}
+
+static int promoDist(enum COLOUR c, int from)
+{
+    int rank = (c == WHITE) ? RANK(from) : 7 - RANK(from);
+    return 7 - rank - ((rank == 1) ? 1 : 0);
+}
+
+/*
+ * A lower bound on the moves a pawn of colour c on from needs to reach
+ * to, or INTEL_FAR. Whatever it does as a promoted piece costs it at least
+ * its way to promotion.
+ */
+static unsigned char pawnDist(enum COLOUR c, int from, int to)
+{
+    int rank = (c == WHITE) ? RANK(from) : 7 - RANK(from);
+    int dr = (c == WHITE) ? RANK(to) - RANK(from) : RANK(from) - RANK(to);
+    int df = abs(FILE(to) - FILE(from));
+    int promo = promoDist(c, from);
+    int d = INTEL_FAR;
+
+    if (to == from) {
+        return 0;
+    }
+
+    if ((dr > 0) && (df <= dr)) {
+        d = dr - (((rank == 1) && (dr >= 2)) ? 1 : 0);
+    }
+
+    return (unsigned char)((promo < d) ? promo : d);
+}
+
+static unsigned char pawnCheckCost(enum COLOUR c, int from, int target)
+{
+    unsigned char best = (unsigned char) promoDist(c, from);
+    int df;
+
+    // The squares a pawn of colour c attacks target from.
+    for (df = -1; df <= 1; df += 2) {
+        int file = FILE(target) + df;
+        int rank = RANK(target) + ((c == WHITE) ? -1 : 1);
+
+        if ((file >= 0) && (file < 8) && (rank >= 0) && (rank < 8)) {
+            unsigned char d = pawnDist(c, from, (rank << 3) | file);
+            best = (d < best) ? d : best;
+        }
+    }
+
+    return best;
+}
+
+static unsigned char pawnCoverCost(enum COLOUR c, int from, int target)
+{
+    unsigned char a = pawnCheckCost(c, from, target);
+    unsigned char b = pawnDist(c, from, target);
+    return (a < b) ? a : b;
+}
+
+/*
+ * Whether at most moves men, one from each of the masks, can do all that
+ * the masks ask: every mask is already a bound on its own.
+ */
+static bool hittable(const uint32_t* masks, int n, int moves)
+{
+    uint32_t first;
+    int i;
+
+    if ((n == 0) || (moves >= 3)) {
+        return true;
+    }
+
+    if (moves == 1) {
+        uint32_t all = masks[0];
+
+        for (i = 1; i < n; i++) {
+            all &= masks[i];
+        }
+
+        return all != 0;
+    }
+
+    // Two moves: one man from the first mask and one for the rest.
+    first = masks[0];
+
+    while (first != 0) {
+        uint32_t man = first & (~first + 1);
+        uint32_t rest = ~(uint32_t) 0;
+        first &= first - 1;
+
+        for (i = 1; i < n; i++) {
+            if ((masks[i] & man) == 0) {
+                rest &= masks[i];
+            }
+        }
+
+        if (rest != 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Whether no mate can be reached from pos in white_moves White and
+ * black_moves Black moves, however the two sides play. Only as many
+ * white men as White has moves can move, so those must between them
+ * check the king and cover each flight that is not already covered or
+ * that Black cannot block.
+ */
+bool intel_unreachable(POSITION* pos, int white_moves, int black_moves)
+{
+    enum PIECE piece[16];
+    unsigned char from[16];
+    unsigned char block[64];
+    unsigned char kdist[64];
+    uint32_t masks[9];
+    BITBOARD zone = 0;
+    BITBOARD area;
+    BITBOARD pcs;
+    int bk = pos->kingsq[BLACK];
+    int reach = black_moves;
+    int wkGain = 0;
+    int men = 0;
+    enum PIECE pc;
+    int sq;
+    int i;
+
+    if (ready == false) {
+        setup();
+    }
+
+    // Castling moves a king two squares at once.
+    if ((pos->flags & (B_KING_CASTLING | B_QUEEN_CASTLING)) != 0) {
+        reach++;
+    }
+
+    if ((pos->flags & (W_KING_CASTLING | W_QUEEN_CASTLING)) != 0) {
+        wkGain = 1;
+    }
+
+    for (sq = 0; sq < 64; sq++) {
+        kdist[sq] = dist[KING][bk][sq];
+
+        if (kdist[sq] <= reach) {
+            zone |= setMask[sq];
+        }
+    }
+
+    // The zone's squares and their flights.
+    area = zone;
+    pcs = zone;
+
+    while (pcs != 0) {
+        sq = tzcount(pcs);
+        pcs &= pcs - 1;
+        area |= king_attacks[sq];
+    }
+
+    (void) memset(block, INTEL_FAR, sizeof(block));
+
+    for (pc = PAWN; pc < KING; pc++) {
+        BITBOARD bm = pos->bitBoard[BLACK][pc];
+        BITBOARD wm = pos->bitBoard[WHITE][pc];
+
+        while (bm != 0) {
+            int f = tzcount(bm);
+            bm &= bm - 1;
+            pcs = area;
+
+            while (pcs != 0) {
+                unsigned char d;
+                sq = tzcount(pcs);
+                pcs &= pcs - 1;
+                d = (pc == PAWN) ? pawnDist(BLACK, f, sq) : dist[pc][f][sq];
+                block[sq] = (d < block[sq]) ? d : block[sq];
+            }
+        }
+
+        while ((wm != 0) && (men < 15)) {
+            piece[men] = pc;
+            from[men++] = (unsigned char) tzcount(wm);
+            wm &= wm - 1;
+        }
+    }
+
+    piece[men] = KING;
+    from[men++] = pos->kingsq[WHITE];
+
+    while (zone != 0) {
+        BITBOARD flights;
+        uint32_t now = 0;
+        uint32_t soon = 0;
+        int n = 0;
+        bool possible = true;
+        sq = tzcount(zone);
+        zone &= zone - 1;
+
+        // The white king never gives check.
+        for (i = 0; i < men - 1; i++) {
+            int c = (piece[i] == PAWN) ? pawnCheckCost(WHITE, from[i], sq)
+                    : checkCost[piece[i]][from[i]][sq];
+            now |= (c == 0) ? (1U << i) : 0;
+            soon |= (c <= white_moves) ? (1U << i) : 0;
+        }
+
+        if (soon == 0) {
+            continue;
+        }
+
+        if (now == 0) {
+            masks[n++] = soon;
+        }
+
+        // A blocker's moves come out of what the king's walk leaves Black.
+        flights = king_attacks[sq];
+
+        while ((flights != 0) && (possible == true)) {
+            int f = tzcount(flights);
+            flights &= flights - 1;
+
+            if ((block[f] + kdist[sq]) <= reach) {
+                continue;
+            }
+
+            now = 0;
+            soon = 0;
+
+            for (i = 0; i < men; i++) {
+                int c;
+
+                if (piece[i] == PAWN) {
+                    c = pawnCoverCost(WHITE, from[i], f);
+                } else if (piece[i] == KING) {
+                    c = coverCost[KING][from[i]][f] - wkGain;
+                } else {
+                    c = coverCost[piece[i]][from[i]][f];
+                }
+
+                now |= (c <= 0) ? (1U << i) : 0;
+                soon |= (c <= white_moves) ? (1U << i) : 0;
+            }
+
+            if (soon == 0) {
+                possible = false;
+            } else if (now == 0) {
+                masks[n++] = soon;
+            }
+        }
+
+        if ((possible == true) && (hittable(masks, n, white_moves) == true)) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -19,16 +19,23 @@
 
 extern enum STIP opt_stip;
 extern bool opt_meson;
+extern bool opt_jsonstats;
+extern unsigned int opt_perft;
+extern bool opt_dag;
+extern enum OUTPUT opt_output;
+extern char* opt_cache;
 extern bool opt_classify;
 extern enum AIM opt_aim;
-extern enum STIP opt_stip;
 extern unsigned int opt_moves;
+extern char* opt_twins;
 
 static clock_t prog_start, prog_end;
 static double run_time;
 enum SOUNDNESS sound;
 
+static int do_problem(void);
 static void do_direct(BOARD*);
+static void classify_direct(DIR_SOL*, BOARD*);
 static void do_self(BOARD*);
 static void do_help(BOARD*);
 static void do_reflex(BOARD*);
@@ -43,95 +50,181 @@ void end_clock(void)
 int main(int argc, char* argv[])
 {
     int rc;
+    unsigned int t;
     prog_start = clock();
     rc = do_options(argc, argv);
 
     if (rc == 0) {
-        BOARD* init_pos;
         init();
         init_mem();
 
-        if (opt_stip == HELP) {
-            init_pos = setup_diagram(WHITE);
-        } else {
-            init_pos = setup_diagram(BLACK);
-        }
+        for (t = 0; (rc == 0) && (t <= twin_count()); t++) {
+            if (t > 0) {
+                // Each twin is timed and counted as a run of its own.
+                prog_start = clock();
+                (void) memset(&stats, 0, sizeof(STATS));
+            }
 
-        rc = validate_board(init_pos);
+            if (opt_twins != NULL) {
+                rc = twin_select(t);
+            }
 
-        if (rc == 0) {
-            switch (opt_stip) {
-            case DIRECT: {
-                do_direct(init_pos);
-                break;
+            if (rc == 0) {
+                rc = do_problem();
             }
+        }
+
+        end_direct();
+        end_self();
+        close_mem();
+    }
+
+    return rc;
+}
+
+/*
+ * Sets up the diagram the options give and solves it.
+ */
+static int do_problem(void)
+{
+    BOARD* init_pos;
+    int rc;
 
-            case SELF:
-                do_self(init_pos);
-                break;
+    if (opt_stip == HELP) {
+        init_pos = setup_diagram(WHITE);
+    } else {
+        init_pos = setup_diagram(BLACK);
+    }
 
-            case REFLEX:
-                do_reflex(init_pos);
-                break;
+    rc = validate_board(init_pos);
 
-            case HELP:
-                do_help(init_pos);
-                break;
+    if ((rc == 0) && (opt_perft > 0)) {
+        do_perft(init_pos);
+        freeBoard(init_pos);
+    } else if (rc == 0) {
+        switch (opt_stip) {
+        case DIRECT: {
+            do_direct(init_pos);
+            break;
+        }
 
-            default:
-                (void) fputs("sengine ERROR: impossible invalid stipulation!!",
-                             stderr);
-                exit(1);
-                break;
-            }
+        case SELF:
+            do_self(init_pos);
+            break;
+
+        case REFLEX:
+            do_reflex(init_pos);
+            break;
+
+        case HELP:
+            do_help(init_pos);
+            break;
 
-            close_mem();
-        } else {
-            close_mem();
-            prog_end = clock();
-            run_time = (double)(prog_end - prog_start) / CLOCKS_PER_SEC;
-            (void) fprintf(stderr, "Running Time = %f\n", run_time);
+        default:
+            (void) fputs("sengine ERROR: impossible invalid stipulation!!",
+                         stderr);
+            exit(1);
+            break;
         }
+    } else {
+        prog_end = clock();
+        run_time = (double)(prog_end - prog_start) / CLOCKS_PER_SEC;
+        (void) fprintf(stderr, "Running Time = %f\n", run_time);
     }
 
     return rc;
 }
 
-void do_direct(BOARD* init_pos)
+static void classify_direct(DIR_SOL* dir_sol, BOARD* init_pos)
+{
+    if ((opt_classify == true) && (opt_aim == MATE) && (opt_stip == DIRECT) && (opt_moves == 2) && (sound == SOUND)
+            && (dir_sol->degraded == false)) {
+        start_phase(PH_CLASSIFY);
+        class_direct_2(dir_sol, init_pos);
+        end_phase(PH_CLASSIFY);
+    }
+
+    return;
+}
+
+/*
+ * Solves with solve, which fills a DIR_SOL, and reports the result as for
+ * directmates. Selfmates share the layout.
+ */
+static void do_dir(BOARD* init_pos, void (*solve)(DIR_SOL*, BOARD*))
 {
     DIR_SOL* dir_sol;
+
+    if ((opt_cache != NULL) && (cache_lookup(init_pos) == true)) {
+        freeBoard(init_pos);
+        return;
+    }
+
     dir_sol = (DIR_SOL*) calloc(1, sizeof(DIR_SOL));
     SENGINE_MEM_ASSERT(dir_sol);
-    solve_direct(dir_sol, init_pos);
-    start_dir();
+    (solve)(dir_sol, init_pos);
+    start_phase(PH_XML);
+
+    if (opt_output != OUT_XML) {
+        // The record is written once the classification has been added.
+        start_record(dir_sol);
+        end_phase(PH_XML);
+        classify_direct(dir_sol, init_pos);
+        start_phase(PH_XML);
+        end_clock();
+        end_record(dir_sol, run_time);
+        end_phase(PH_XML);
+    } else {
+        if (opt_dag == true) {
+            share_dir_lists(dir_sol);
+        }
 
-    if (dir_sol->set != NULL) {
-        add_dir_set(dir_sol->set);
-    }
+        start_dir(dir_sol->degraded);
 
-    if (dir_sol->tries != NULL) {
-        add_dir_tries(dir_sol->tries);
-    }
+        if (dir_sol->set != NULL) {
+            add_dir_set(dir_sol->set);
+        }
 
-    if (dir_sol->keys != NULL) {
-        add_dir_keys(dir_sol->keys);
-    }
+        if (dir_sol->tries != NULL) {
+            add_dir_tries(dir_sol->tries);
+        }
 
-    if (opt_meson == false) {
-        add_dir_options();
-        add_dir_stats(dir_sol);
-    }
+        if (dir_sol->keys != NULL) {
+            add_dir_keys(dir_sol->keys);
+        }
 
-    end_clock();
+        if (dir_sol->unresolved != NULL) {
+            add_dir_unresolved(dir_sol->unresolved);
+        }
 
-    if (opt_meson == false) {
-        time_dir(run_time);
+        // The XML time reported is up to the stats element itself.
+        end_phase(PH_XML);
+
+        if (opt_meson == false) {
+            add_dir_options();
+            add_dir_stats(dir_sol);
+        }
+
+        start_phase(PH_XML);
+        end_clock();
+
+        if (opt_meson == false) {
+            time_dir(run_time);
+        }
+
+        end_dir();
+        end_phase(PH_XML);
+        classify_direct(dir_sol, init_pos);
     }
 
-    end_dir();
+    if (opt_cache != NULL) {
+        // Results cut short by a limit are written but never stored.
+        cache_store((sound != RESOURCE_LIMIT) && (sound != TIMEOUT) && (sound != PARTIAL)
+                    && (dir_sol->degraded == false));
+    }
 
-    if ((opt_classify == true) && (opt_aim == MATE) && (opt_stip == DIRECT) && (opt_moves == 2) && (sound == SOUND)) {
-        class_direct_2(dir_sol, init_pos);
+    if (opt_jsonstats == true) {
+        print_stats_json(stderr, dir_sol->hash_hit_null, dir_sol->hash_hit_list);
     }
 
     if (dir_sol->set != NULL) {
@@ -146,32 +239,76 @@ void do_direct(BOARD* init_pos)
         freeBoardlist(dir_sol->keys);
     }
 
+    if (dir_sol->unresolved != NULL) {
+        freeBoardlist(dir_sol->unresolved);
+    }
+
     free(dir_sol);
     freeBoard(init_pos);
     return;
 }
 
+void do_direct(BOARD* init_pos)
+{
+    do_dir(init_pos, solve_direct);
+    return;
+}
+
 static void do_self(BOARD* init_pos)
 {
-    (void) fputs("sengine ERROR: Can't solve selfmates yet!\n",
-                 stderr);
-    exit(1);
+    do_dir(init_pos, solve_self);
     return;
 }
 
 static void do_help(BOARD* init_pos)
 {
-    (void) fputs("sengine ERROR: Can't solve helpmates yet!\n",
-                 stderr);
-    exit(1);
+    HELP_SOL* help_sol;
+
+    if ((opt_cache != NULL) && (cache_lookup(init_pos) == true)) {
+        freeBoard(init_pos);
+        return;
+    }
+
+    help_sol = (HELP_SOL*) calloc(1, sizeof(HELP_SOL));
+    SENGINE_MEM_ASSERT(help_sol);
+    solve_help(help_sol, init_pos);
+    start_phase(PH_XML);
+    start_dir(false);
+    add_help_sols(help_sol->sols);
+    end_phase(PH_XML);
+
+    if (opt_meson == false) {
+        add_dir_options();
+        add_help_stats(help_sol);
+    }
+
+    start_phase(PH_XML);
+    end_clock();
+
+    if (opt_meson == false) {
+        time_dir(run_time);
+    }
+
+    end_dir();
+    end_phase(PH_XML);
+
+    if (opt_cache != NULL) {
+        cache_store(true);
+    }
+
+    if (opt_jsonstats == true) {
+        print_stats_json(stderr, help_sol->hash_hit_null, 0);
+    }
+
+    freeBoardlist(help_sol->sols);
+    free(help_sol);
+    freeBoard(init_pos);
     return;
 }
 
 static void do_reflex(BOARD* init_pos)
 {
-    (void) fputs("sengine ERROR: Can't solve reflexmates yet!\n",
-                 stderr);
-    exit(1);
+    do_dir(init_pos, solve_reflex);
     return;
 }
 
@@ -27,14 +27,68 @@
 #define SENGINE_PIN_STATUS_BLOCKSIZE 10
 
 extern bool opt_classify;
+extern unsigned int opt_memory;
 
-static pool pos_pool_ptr;
-static pool hval_pool_ptr;
-static pool blist_pool_ptr;
-static pool board_pool_ptr;
-static pool idb_pool_ptr;
-static pool csl_pool_ptr;
-static pool ps_pool_ptr;
+/*
+ *	Each search thread has pools of its own, so nothing it allocates or
+ *	frees is shared; --memory is a budget for each of them.
+ */
+
+static __thread pool pos_pool_ptr;
+static __thread pool hval_pool_ptr;
+static __thread pool blist_pool_ptr;
+static __thread pool board_pool_ptr;
+static __thread pool idb_pool_ptr;
+static __thread pool csl_pool_ptr;
+static __thread pool ps_pool_ptr;
+static __thread size_t mem_used = 0;
+static __thread uint64_t boards_live = 0;
+static __thread uint64_t positions_live = 0;
+static __thread uint64_t boardlists_live = 0;
+static __thread uint64_t hashvalues_live = 0;
+
+static void poolTaken(uint64_t* live, uint64_t* peak)
+{
+    if (++(*live) > *peak) {
+        *peak = *live;
+    }
+
+    if (mem_used > stats.mem_peak) {
+        stats.mem_peak = mem_used;
+    }
+
+    return;
+}
+
+/*
+ *	Only the structures that make up the solution tree and the transposition
+ *	table are counted against --memory; everything else is small and fixed.
+ */
+
+enum MEMSTATE memoryPressure(void)
+{
+    size_t budget;
+
+    if (opt_memory == 0) {
+        return MEM_OK;
+    }
+
+    budget = (size_t) opt_memory << 20;
+
+    if (mem_used >= budget) {
+        return MEM_EXHAUSTED;
+    }
+
+    if (mem_used >= ((budget / 10) * 9)) {
+        return MEM_DROP;
+    }
+
+    if (mem_used >= ((budget / 4) * 3)) {
+        return MEM_EVICT;
+    }
+
+    return MEM_OK;
+}
 
 void init_mem(void)
 {
@@ -155,6 +209,8 @@ BOARD* getBoard(POSITION* ppos, unsigned char played, unsigned char move)
     //rpbrd = calloc(1, sizeof(BOARD));
     rpbrd = (BOARD*) poolMalloc(&board_pool_ptr);
     SENGINE_MEM_ASSERT(rpbrd);
+    mem_used += sizeof(BOARD);
+    poolTaken(&boards_live, &stats.board_peak);
     memset((void*) rpbrd, 0, sizeof(BOARD));
     rpbrd->pos = getPosition(ppos);
     rpbrd->tag = '*';
@@ -170,6 +226,8 @@ BOARD* cloneBoard(BOARD* inBrd)
     BOARD* rpbrd;
     rpbrd = (BOARD*) poolMalloc(&board_pool_ptr);
     SENGINE_MEM_ASSERT(rpbrd);
+    mem_used += sizeof(BOARD);
+    poolTaken(&boards_live, &stats.board_peak);
     memcpy((void*) rpbrd, (void*) inBrd, sizeof(BOARD));
     rpbrd->next = NULL;
     return rpbrd;
@@ -180,6 +238,8 @@ POSITION* getPosition(POSITION* ppos)
     POSITION* rpos;
     rpos = (POSITION*) poolMalloc(&pos_pool_ptr);
     SENGINE_MEM_ASSERT(rpos);
+    mem_used += sizeof(POSITION);
+    poolTaken(&positions_live, &stats.position_peak);
     memcpy(rpos, ppos, sizeof(POSITION));
     return rpos;
 }
@@ -195,12 +255,16 @@ HASHVALUE* getHashValue(void)
 {
     HASHVALUE* hv = (HASHVALUE*) poolMalloc(&hval_pool_ptr);
     SENGINE_MEM_ASSERT(hv);
+    mem_used += sizeof(HASHVALUE);
+    poolTaken(&hashvalues_live, &stats.hashvalue_peak);
     memset((void*) hv, 0, sizeof(HASHVALUE));
     return hv;
 }
 
 void freeHashValue(HASHVALUE* ptr)
 {
+    mem_used -= sizeof(HASHVALUE);
+    hashvalues_live--;
     poolFree(&hval_pool_ptr, ptr);
     return;
 }
@@ -210,6 +274,8 @@ BOARDLIST* getBoardlist(unsigned char tplay, unsigned char move)
     BOARDLIST* pbl;
     pbl = (BOARDLIST*) poolMalloc(&blist_pool_ptr);
     SENGINE_MEM_ASSERT(pbl);
+    mem_used += sizeof(BOARDLIST);
+    poolTaken(&boardlists_live, &stats.boardlist_peak);
     memset((void*) pbl, 0, sizeof(BOARDLIST));
     pbl->toPlay = tplay;
     pbl->moveNumber = move;
@@ -235,6 +301,8 @@ void freeBoard(BOARD* pbrd)
     }
 
     poolFree(&board_pool_ptr, pbrd);
+    mem_used -= sizeof(BOARD);
+    boards_live--;
 
     return;
 }
@@ -243,6 +311,8 @@ void freePosition(POSITION* ppos)
 {
     assert(ppos != NULL);
     poolFree(&pos_pool_ptr, ppos);
+    mem_used -= sizeof(POSITION);
+    positions_live--;
     return;
 }
 
@@ -261,6 +331,8 @@ void freeBoardlist(BOARDLIST* pbl)
         }
 
         poolFree(&blist_pool_ptr, pbl);
+        mem_used -= sizeof(BOARDLIST);
+        boardlists_live--;
     }
 
     return;
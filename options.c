@@ -272,6 +272,274 @@ static int val_hash(char* instr, ARGUMENT* arg)
     return rc;
 }
 
+static int val_memory(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+    char* ptr;
+    char numbers[] = "0123456789";
+    long m;
+    ptr = instr + 8;
+
+    if (*ptr == '=') {
+        ptr++;
+
+        if ((*ptr != '\0') && (strlen(ptr) < 7)) {
+            if (strspn(ptr, numbers) == strlen(ptr)) {
+                m = atol(ptr);
+
+                if (m > 0) {
+                    rc = 0;
+                    opt_memory = (unsigned int) m;
+                }
+            }
+        }
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
+static int val_timelimit(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+    char* ptr;
+    char numbers[] = "0123456789";
+    long t;
+    ptr = instr + 11;
+
+    if (*ptr == '=') {
+        ptr++;
+
+        if ((*ptr != '\0') && (strlen(ptr) < 8)) {
+            if (strspn(ptr, numbers) == strlen(ptr)) {
+                t = atol(ptr);
+
+                if (t > 0) {
+                    rc = 0;
+                    opt_timelimit = (unsigned int) t;
+                }
+            }
+        }
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
+static int val_nodelimit(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+    char* ptr;
+    char numbers[] = "0123456789";
+    unsigned long long n;
+    ptr = instr + 11;
+
+    if (*ptr == '=') {
+        ptr++;
+
+        if ((*ptr != '\0') && (strlen(ptr) < 19)) {
+            if (strspn(ptr, numbers) == strlen(ptr)) {
+                n = strtoull(ptr, NULL, 10);
+
+                if (n > 0) {
+                    rc = 0;
+                    opt_nodelimit = (uint64_t) n;
+                }
+            }
+        }
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
+static int val_checkpoint(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+    char* ptr;
+    ptr = instr + 12;
+
+    if ((*ptr == '=') && (*(ptr + 1) != '\0')) {
+        rc = 0;
+        opt_checkpoint = ptr + 1;
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
+static int val_tb(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+    char* ptr;
+    ptr = instr + 4;
+
+    if ((*ptr == '=') && (*(ptr + 1) != '\0')) {
+        rc = 0;
+        opt_tb = ptr + 1;
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
+static int val_cache(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+    char* ptr;
+    ptr = instr + 7;
+
+    if ((*ptr == '=') && (*(ptr + 1) != '\0')) {
+        rc = 0;
+        opt_cache = ptr + 1;
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
+static int val_twins(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+    char* ptr;
+    ptr = instr + 7;
+
+    if ((*ptr == '=') && (twin_valid(ptr + 1) == true)) {
+        rc = 0;
+        opt_twins = ptr + 1;
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
+static int val_resume(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+    char* ptr;
+    ptr = instr + 8;
+
+    if ((*ptr == '=') && (*(ptr + 1) != '\0')) {
+        rc = 0;
+        opt_resume = ptr + 1;
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
+static int val_shard(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+    char* ptr;
+    char numbers[] = "0123456789";
+    long i, n;
+    size_t len;
+    ptr = instr + 7;
+
+    /*
+     * Pattern after '--shard' should be:
+     * /^=[0-9]+\/[0-9]+$/
+     * with 1 <= i <= n.
+     */
+
+    if (*ptr == '=') {
+        ptr++;
+        len = strspn(ptr, numbers);
+
+        if ((len > 0) && (len < 5) && (ptr[len] == '/')) {
+            i = atol(ptr);
+            ptr += len + 1;
+            len = strlen(ptr);
+
+            if ((len > 0) && (len < 5) && (strspn(ptr, numbers) == len)) {
+                n = atol(ptr);
+
+                if ((i >= 1) && (i <= n)) {
+                    rc = 0;
+                    opt_shard = (unsigned int) i;
+                    opt_shards = (unsigned int) n;
+                }
+            }
+        }
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
+static int val_merge(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+    char* ptr;
+    ptr = instr + 7;
+
+    if ((*ptr == '=') && (*(ptr + 1) != '\0')) {
+        rc = 0;
+        opt_merge = ptr + 1;
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
+static int val_stats(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+
+    if (strcmp(instr + 7, "=json") == 0) {
+        rc = 0;
+        opt_jsonstats = true;
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
 static int val_stip(char* instr, ARGUMENT* arg)
 {
     int rc = 1;
@@ -406,6 +674,69 @@ static int val_classify(char* instr, ARGUMENT* arg)
     return rc;
 }
 
+static int val_divide(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+
+    if (strlen(instr) == 8) {
+        rc = 0;
+        opt_divide = true;
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
+static int val_dag(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+
+    if (strlen(instr) == 5) {
+        rc = 0;
+        opt_dag = true;
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
+static int val_output(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+    char* ptr;
+    ptr = instr + 8;
+
+    if (*ptr == '=') {
+        ptr++;
+
+        if (strcmp(ptr, "xml") == 0) {
+            rc = 0;
+            opt_output = OUT_XML;
+        } else if (strcmp(ptr, "jsonl") == 0) {
+            rc = 0;
+            opt_output = OUT_JSONL;
+        } else if (strcmp(ptr, "bin") == 0) {
+            rc = 0;
+            opt_output = OUT_BIN;
+        }
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
 static int val_help(char* instr, ARGUMENT* arg)
 {
     int rc = 1;
@@ -508,6 +839,57 @@ static int val_fleck(char* instr, ARGUMENT* arg)
     return rc;
 }
 
+static int val_intelligent(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+
+    if (strlen(instr) == 13) {
+        rc = 0;
+        opt_intelligent = true;
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
+static int val_threads(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+
+    if (strlen(instr) == 9) {
+        rc = 0;
+        opt_threads = true;
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
+static int val_mitm(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+
+    if (strlen(instr) == 6) {
+        rc = 0;
+        opt_mitm = true;
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
 static int val_meson(char* instr, ARGUMENT* arg)
 {
     int rc = 1;
@@ -525,6 +907,23 @@ static int val_meson(char* instr, ARGUMENT* arg)
     return rc;
 }
 
+static int val_quick(char* instr, ARGUMENT* arg)
+{
+    int rc = 1;
+
+    if (strlen(instr) == 7) {
+        rc = 0;
+        opt_quick = true;
+    }
+
+    if (rc != 0) {
+        (void) fprintf(stderr, "sengine ERROR: invalid option => %s\n",
+                       instr);
+    }
+
+    return rc;
+}
+
 static int val_unimplemented(char* instr, ARGUMENT* arg)
 {
     (void) fprintf(stderr,
@@ -543,13 +942,29 @@ static void set_up_argtable(void)
         {"--castling", false, &opt_castling, val_castling},
         {"--ep", false, &opt_ep, val_ep},
         {"--hash", false, &opt_hash, val_hash},
+        {"--memory", false, &opt_memory, val_memory},
+        {"--timelimit", false, &opt_timelimit, val_timelimit},
+        {"--nodelimit", false, &opt_nodelimit, val_nodelimit},
+        {"--checkpoint", false, &opt_checkpoint, val_checkpoint},
+        {"--resume", false, &opt_resume, val_resume},
+        {"--shard", false, &opt_shard, val_shard},
+        {"--merge", false, &opt_merge, val_merge},
+        {"--cache", false, &opt_cache, val_cache},
+        {"--twins", false, &opt_twins, val_twins},
+        {"--tb", false, &opt_tb, val_tb},
+        {"--stats", false, &opt_jsonstats, val_stats},
+        {"--perft", false, &opt_perft, val_number},
+        {"--divide", false, &opt_divide, val_divide},
+        {"--dag", false, &opt_dag, val_dag},
+        {"--output", false, &opt_output, val_output},
         {"--stip", false, &opt_stip, val_stip},
         {"--threats", false, &opt_threats, val_threats},
         {"--moves", false, &opt_moves, val_number},
         {"--sols", false, &opt_sols, val_number},
         {"--refuts", false, &opt_refuts, val_number},
         {"--help", false, &opt_help, val_help},
-        {"--threads", false, &opt_threads, val_unimplemented},
+        {"--threads", false, &opt_threads, val_threads},
+        {"--mitm", false, &opt_mitm, val_mitm},
         {"--set", false, &opt_set, val_set},
         {"--tries", false, &opt_tries, val_tries},
         {"--trivialtries", false, &opt_trivialtries, val_trivialtries},
@@ -557,8 +972,9 @@ static void set_up_argtable(void)
         {"--shortvars", false, &opt_shortvars, val_shortvars},
         {"--fleck", false, &opt_fleck, val_fleck},
         {"--meson", false, &opt_meson, val_meson},
+        {"--quick", false, &opt_quick, val_quick},
         {"--virtualthreats", false, &opt_virtualthreats, val_unimplemented},
-        {"--intelligent", false, &opt_intelligent, val_unimplemented},
+        {"--intelligent", false, &opt_intelligent, val_intelligent},
         {"--postkeyplay", false, &opt_postkeyplay, val_unimplemented},
         {"--classify", false, &opt_classify, val_classify},
     };
@@ -640,7 +1056,71 @@ static int val_combinations(void)
             rc++;
             fputs("sengine ERROR: --shortvars not valid for helpmates", stderr);
         }
+
+        if (opt_set == true) {
+            rc++;
+            fputs("sengine ERROR: --set not valid for helpmates", stderr);
+        }
+
+        if (opt_output != OUT_XML) {
+            rc++;
+            fputs("sengine ERROR: --output not valid for helpmates", stderr);
+        }
+
+        if ((opt_checkpoint != NULL) || (opt_resume != NULL) || (opt_shards != 0)
+                || (opt_merge != NULL)) {
+            rc++;
+            fputs("sengine ERROR: --checkpoint, --resume, --shard and --merge not valid for helpmates",
+                  stderr);
+        }
+
+        if ((opt_timelimit != 0) || (opt_nodelimit != 0)) {
+            rc++;
+            fputs("sengine ERROR: --timelimit and --nodelimit not valid for helpmates",
+                  stderr);
+        }
     } else {
+        if (opt_threads == true) {
+            rc++;
+            fputs("sengine ERROR: --threads only valid for helpmates", stderr);
+        }
+
+        if (opt_mitm == true) {
+            rc++;
+            fputs("sengine ERROR: --mitm only valid for helpmates", stderr);
+        }
+
+        if ((opt_stip == SELF) || (opt_stip == REFLEX)) {
+            if (opt_set == true) {
+                rc++;
+                fputs("sengine ERROR: --set not valid for self- and reflexmates", stderr);
+            }
+
+            if (opt_fleck == true) {
+                rc++;
+                fputs("sengine ERROR: --fleck not valid for self- and reflexmates", stderr);
+            }
+
+            if (opt_intelligent == true) {
+                rc++;
+                fputs("sengine ERROR: --intelligent not valid for self- and reflexmates",
+                      stderr);
+            }
+
+            if ((opt_checkpoint != NULL) || (opt_resume != NULL) || (opt_shards != 0)
+                    || (opt_merge != NULL)) {
+                rc++;
+                fputs("sengine ERROR: --checkpoint, --resume, --shard and --merge not valid for self- and reflexmates",
+                      stderr);
+            }
+
+            if ((opt_timelimit != 0) || (opt_nodelimit != 0)) {
+                rc++;
+                fputs("sengine ERROR: --timelimit and --nodelimit not valid for self- and reflexmates",
+                      stderr);
+            }
+        }
+
         if (opt_postkeyplay == true) {
             if (opt_set == true) {
                 rc++;
@@ -682,6 +1162,71 @@ static int val_combinations(void)
         }
     }
 
+    if (opt_quick == true) {
+        if (opt_stip != DIRECT) {
+            rc++;
+            fputs("sengine ERROR: --quick only valid for directmates", stderr);
+        }
+
+        if ((opt_tries == true) || (opt_set == true) || (opt_classify == true)) {
+            rc++;
+            fputs("sengine ERROR: --quick not valid with --tries, --set or --classify",
+                  stderr);
+        }
+
+        if ((opt_checkpoint != NULL) || (opt_resume != NULL) || (opt_shards != 0)
+                || (opt_merge != NULL)) {
+            rc++;
+            fputs("sengine ERROR: --quick not valid with --checkpoint, --resume, --shard or --merge",
+                  stderr);
+        }
+
+        // Only the keys are looked for, and only one refutation is needed
+        // to dismiss a move.
+        opt_actual = true;
+        opt_refuts = 0;
+        opt_threats = NONE;
+    }
+
+    if ((opt_shards != 0) && (opt_checkpoint == NULL)) {
+        rc++;
+        fputs("sengine ERROR: --shard needs --checkpoint for its result", stderr);
+    }
+
+    if ((opt_divide == true) && (opt_perft == 0)) {
+        rc++;
+        fputs("sengine ERROR: --divide only valid with --perft", stderr);
+    }
+
+    if ((opt_cache != NULL) && ((opt_shards != 0) || (opt_perft != 0))) {
+        rc++;
+        fputs("sengine ERROR: --cache not valid with --shard or --perft", stderr);
+    }
+
+    if ((opt_twins != NULL) && ((opt_checkpoint != NULL) || (opt_resume != NULL)
+                                || (opt_shards != 0) || (opt_merge != NULL))) {
+        rc++;
+        fputs("sengine ERROR: --twins not valid with --checkpoint, --resume, --shard or --merge",
+              stderr);
+    }
+
+    if ((opt_dag == true) && (opt_output != OUT_XML)) {
+        rc++;
+        fputs("sengine ERROR: --dag only valid with --output=xml", stderr);
+    }
+
+    if ((opt_merge != NULL) && ((opt_shards != 0) || (opt_resume != NULL))) {
+        rc++;
+        fputs("sengine ERROR: --merge not valid with --shard or --resume", stderr);
+    }
+
+    // The threats and the set play of a run take the transposition table
+    // its whole search built, which the shards each only built part of.
+    if ((opt_merge != NULL) && ((opt_set == true) || (opt_threats != NONE))) {
+        rc++;
+        fputs("sengine ERROR: --merge needs --threats=NONE and is not valid with --set", stderr);
+    }
+
     // kings and pos must be compatible
     {
         char kg[3];
@@ -760,6 +1305,21 @@ void do_usage(void)
     (void) fputs(" [--refuts=i]       Number of refutations for tries (default = 0) 1-9 are valid\n", stderr);
     (void) fputs(" [--threats=s]      Calculate threats - NONE, SHORTEST (the default) or ALL\n", stderr);
     (void) fputs(" [--hash=n]         Set size (max 150,000), in number of entries, for hash table\n", stderr);
+    (void) fputs(" [--memory=n]       Memory budget in MB; the search degrades, then stops, rather than failing\n", stderr);
+    (void) fputs(" [--timelimit=n]    Stop after n seconds and report the first moves left unresolved\n", stderr);
+    (void) fputs(" [--nodelimit=n]    Stop after n nodes and report the first moves left unresolved\n", stderr);
+    (void) fputs(" [--checkpoint=f]   Write each completed first move to file f\n", stderr);
+    (void) fputs(" [--resume=f]       Skip the first moves already completed in checkpoint file f\n", stderr);
+    (void) fputs(" [--shard=i/n]      Search only every n-th first move, starting with the i-th\n", stderr);
+    (void) fputs(" [--merge=f,f,...]  Combine the checkpoint files written by --shard runs (--threats=NONE)\n", stderr);
+    (void) fputs(" [--cache=d]        Reuse and store finished results in directory d\n", stderr);
+    (void) fputs(" [--tb=d]           Also use four man tablebases, built once into directory d\n", stderr);
+    (void) fputs(" [--twins=s]        Also solve twins, each a list of changes to the diagram - eg. d2d4,-h7/+wSe5\n", stderr);
+    (void) fputs(" [--stats=json]     Write the search statistics to stderr as JSON\n", stderr);
+    (void) fputs(" [--perft=i]        Count the leaf nodes i plies deep (1-9) instead of solving\n", stderr);
+    (void) fputs(" [--divide]         With --perft, also count each first move separately\n", stderr);
+    (void) fputs(" [--dag]            Output each shared variation once and refer to it elsewhere\n", stderr);
+    (void) fputs(" [--output=s]       Output format - xml (the default), jsonl or bin\n", stderr);
     (void) fputs(" [--help]           Display this help message\n", stderr);
     (void) fputs(" [--set]            Calculate set play\n", stderr);
     (void) fputs(" [--tries]          Calculate tries\n", stderr);
@@ -767,8 +1327,12 @@ void do_usage(void)
     (void) fputs(" [--actual]         Calculate actual play\n", stderr);
     (void) fputs(" [--shortvars]      Include short variations\n", stderr);
     (void) fputs(" [--fleck]          Retain variations that allow some (but not all) of the threats\n", stderr);
-    (void) fputs(" [--meson]          Running from Meson database, default is false\n", stderr);
+    (void) fputs(" [--meson]          Running from Meson database, giving tries with just their refutations\n", stderr);
     (void) fputs(" [--classify]       Classify problem\n", stderr);
+    (void) fputs(" [--quick]          Find only whether a directmate is sound, stopping at a second key\n", stderr);
+    (void) fputs(" [--intelligent]    Skip positions from which no mate can be reached in the moves left\n", stderr);
+    (void) fputs(" [--threads]        Share a helpmate's first moves between a thread for each CPU\n", stderr);
+    (void) fputs(" [--mitm]           Solve a helpmate's two halves apart and join them where they meet\n", stderr);
 
     return;
 }
@@ -812,6 +1376,21 @@ void show_options()
     (void) fprintf(stderr, "opt_castling       => /%s/\n", opt_castling);
     (void) fprintf(stderr, "opt_ep             => /%s/\n", opt_ep);
     (void) fprintf(stderr, "opt_hash           => /%d/\n", opt_hash);
+    (void) fprintf(stderr, "opt_memory         => /%u/\n", opt_memory);
+    (void) fprintf(stderr, "opt_timelimit      => /%u/\n", opt_timelimit);
+    (void) fprintf(stderr, "opt_nodelimit      => /%llu/\n", (unsigned long long) opt_nodelimit);
+    (void) fprintf(stderr, "opt_checkpoint     => /%s/\n", opt_checkpoint);
+    (void) fprintf(stderr, "opt_resume         => /%s/\n", opt_resume);
+    (void) fprintf(stderr, "opt_shard          => /%u/%u/\n", opt_shard, opt_shards);
+    (void) fprintf(stderr, "opt_merge          => /%s/\n", opt_merge);
+    (void) fprintf(stderr, "opt_cache          => /%s/\n", opt_cache);
+    (void) fprintf(stderr, "opt_tb             => /%s/\n", opt_tb);
+    (void) fprintf(stderr, "opt_twins          => /%s/\n", opt_twins);
+    (void) fprintf(stderr, "opt_jsonstats      => /%d/\n", opt_jsonstats);
+    (void) fprintf(stderr, "opt_perft          => /%u/\n", opt_perft);
+    (void) fprintf(stderr, "opt_divide         => /%d/\n", opt_divide);
+    (void) fprintf(stderr, "opt_dag            => /%d/\n", opt_dag);
+    (void) fprintf(stderr, "opt_output         => /%d/\n", opt_output);
     (void) fprintf(stderr, "opt_aim            => /%d/\n", opt_aim);
     (void) fprintf(stderr, "opt_threats        => /%d/\n", opt_threats);
     (void) fprintf(stderr, "opt_stip           => /%d/\n", opt_stip);
@@ -820,6 +1399,7 @@ void show_options()
     (void) fprintf(stderr, "opt_refuts         => /%d/\n", opt_refuts);
     (void) fprintf(stderr, "opt_help           => /%d/\n", opt_help);
     (void) fprintf(stderr, "opt_threads        => /%d/\n", opt_threads);
+    (void) fprintf(stderr, "opt_mitm           => /%d/\n", opt_mitm);
     (void) fprintf(stderr, "opt_set            => /%d/\n", opt_set);
     (void) fprintf(stderr, "opt_tries          => /%d/\n", opt_tries);
     (void) fprintf(stderr, "opt_trivialtries   => /%d/\n", opt_trivialtries);
@@ -832,6 +1412,7 @@ void show_options()
     (void) fprintf(stderr, "opt_postkeyplay    => /%d/\n", opt_postkeyplay);
     (void) fprintf(stderr, "opt_classify       => /%d/\n", opt_classify);
     (void) fprintf(stderr, "opt_meson          => /%d/\n", opt_meson);
+    (void) fprintf(stderr, "opt_quick          => /%d/\n", opt_quick);
     (void) fputs("options::show_options() ending\n", stderr);
     return;
 }
@@ -17,7 +17,7 @@
  *
  */
 
-#define ARGTYPES 24
+#define ARGTYPES 41
 #define NUMSTIPS 8
 
 char* opt_kings = NULL;
@@ -26,6 +26,22 @@ char* opt_pos = NULL;
 char* opt_castling = NULL;
 char* opt_ep = NULL;
 int opt_hash = MAX_HASH_SIZE;
+unsigned int opt_memory = 0;
+unsigned int opt_timelimit = 0;
+uint64_t opt_nodelimit = 0;
+char* opt_checkpoint = NULL;
+char* opt_resume = NULL;
+unsigned int opt_shard = 0;
+unsigned int opt_shards = 0;
+char* opt_merge = NULL;
+char* opt_cache = NULL;
+char* opt_twins = NULL;
+char* opt_tb = NULL;
+bool opt_jsonstats = false;
+unsigned int opt_perft = 0;
+bool opt_divide = false;
+bool opt_dag = false;
+enum OUTPUT opt_output = OUT_XML;
 enum AIM opt_aim = MATE;
 enum THREATS opt_threats = SHORTEST;
 enum STIP opt_stip = DIRECT;
@@ -34,6 +50,7 @@ unsigned int opt_sols = 1;
 unsigned int opt_refuts = 0;
 bool opt_help = false;
 bool opt_threads = false;
+bool opt_mitm = false;
 bool opt_set = false;
 bool opt_tries = false;
 bool opt_trivialtries = false;
@@ -45,6 +62,7 @@ bool opt_intelligent = false;
 bool opt_postkeyplay = false;
 bool opt_classify = false;
 bool opt_meson = false;
+bool opt_quick = false;
 
 typedef struct argument {
     char* name;
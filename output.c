@@ -0,0 +1,505 @@
+/*
+ *	output.c
+ *	(c) 2020, Brian Stephenson
+ *	brian@bstephen.me.uk
+ *
+ *	A program to test orthodox chess problems of the types:
+ *
+ *		directmates
+ *		selfmates
+ *		relfexmates
+ *		helpmates
+ *
+ *	Input is taken from the program options and output is xml on stdout.
+ *
+ *	This is the module for --output=jsonl and --output=bin. Each problem is
+ *	written as one self-contained record, built in memory straight from the
+ *	DIR_SOL trees and the classification and written to stdout in one go.
+ *
+ *	jsonl: one JSON object and a newline. A move is {"move":"1.Qd4!"}, with
+ *	"threat" and "next" arrays of moves where the solution has them.
+ *
+ *	bin: an unsigned LEB128 varint giving the length of the payload, then:
+ *		byte     format version (2)
+ *		string   program, then diagram as kings:gbr:pos
+ *		byte     stip, aim, moves, soundness (the enum values)
+ *		byte     1 if the result is degraded by --memory, else 0
+ *		string   castling, then ep ("" when not given)
+ *		list     set, tries, keys, unresolved (count 0 when absent)
+ *		events   classification, ended by a 0 byte
+ *		byte     1 if the stats follow (not with --meson), else 0
+ *		varint   stats counters, in the order of writeBinStats(),
+ *		         then the running time in microseconds
+ *	A string is a varint length and its bytes; a list is a varint count and
+ *	that many moves; a move is the bytes from, to, mover | promotion << 3
+ *	| captured << 6 | check << 7, tag, ep | has threat << 1 | ply << 4,
+ *	then the qualifier string, the threat list if any and the next list.
+ *	A classification event is 1 start (name), 2 text (name, text), 3 int
+ *	(name, zigzag varint) or 4 end.
+ */
+
+#include "sengine.h"
+
+#define CLASS_DEPTH 16
+
+enum CLASSEVENT { EV_DONE, EV_START, EV_TEXT, EV_INT, EV_END };
+
+extern enum OUTPUT opt_output;
+extern bool opt_meson;
+extern char* opt_kings;
+extern char* opt_gbr;
+extern char* opt_pos;
+extern char* opt_castling;
+extern char* opt_ep;
+extern enum SOUNDNESS sound;
+extern enum STIP opt_stip;
+extern enum AIM opt_aim;
+extern unsigned int opt_moves;
+extern unsigned int opt_sols;
+extern unsigned int opt_refuts;
+extern bool opt_set;
+extern bool opt_tries;
+extern bool opt_trivialtries;
+extern bool opt_actual;
+extern enum THREATS opt_threats;
+extern bool opt_fleck;
+extern bool opt_shortvars;
+
+static const char* const soundness_names[] = {
+    "UNSET", "SHORT_SOLUTION", "SOUND", "COOKED", "NO_SOLUTION",
+    "MISSING_SOLUTION", "RESOURCE_LIMIT", "TIMEOUT", "PARTIAL"
+};
+static const char* const threats_names[] = { "ALL", "NONE", "SHORTEST" };
+
+// Repeated classification elements, written as JSON arrays.
+static const char* const class_arrays[] = { "Type", "Var", "Try", "Threat", "Refut" };
+
+static UT_string* rec = NULL;
+static int class_depth;
+static bool class_first[CLASS_DEPTH];
+static const char* class_array[CLASS_DEPTH];
+
+static void putVarint(uint64_t v)
+{
+    unsigned char b[10];
+    int n = 0;
+
+    while (v >= 0x80) {
+        b[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+
+    b[n++] = (unsigned char) v;
+    utstring_bincpy(rec, b, n);
+    return;
+}
+
+static void putByte(unsigned int v)
+{
+    unsigned char b = (unsigned char) v;
+    utstring_bincpy(rec, &b, 1);
+    return;
+}
+
+static void putString(const char* s)
+{
+    size_t n = (s == NULL) ? 0 : strlen(s);
+    putVarint(n);
+    utstring_bincpy(rec, s, n);
+    return;
+}
+
+static void putJsonString(const char* s)
+{
+    utstring_bincpy(rec, "\"", 1);
+
+    for (; *s != '\0'; s++) {
+        switch (*s) {
+        case '"':
+            utstring_bincpy(rec, "\\\"", 2);
+            break;
+
+        case '\\':
+            utstring_bincpy(rec, "\\\\", 2);
+            break;
+
+        default:
+            if ((unsigned char) *s < 0x20) {
+                utstring_printf(rec, "\\u%04x", (unsigned int)(unsigned char) *s);
+            } else {
+                utstring_bincpy(rec, s, 1);
+            }
+
+            break;
+        }
+    }
+
+    utstring_bincpy(rec, "\"", 1);
+    return;
+}
+
+static void putJsonKey(const char* key)
+{
+    putJsonString(key);
+    utstring_bincpy(rec, ":", 1);
+    return;
+}
+
+static void writeJsonList(BOARDLIST*);
+
+static void writeJsonMove(BOARD* brd)
+{
+    char move[MOVESTR_LEN];
+    utstring_printf(rec, "{\"move\":\"%s\"", toStr(brd, move));
+
+    if (brd->threat != NULL) {
+        utstring_printf(rec, ",\"threat\":");
+        writeJsonList(brd->threat);
+    }
+
+    if ((brd->nextply != NULL) && (brd->nextply->vektor != NULL)) {
+        utstring_printf(rec, ",\"next\":");
+        writeJsonList(brd->nextply);
+    }
+
+    utstring_bincpy(rec, "}", 1);
+    return;
+}
+
+static void writeJsonList(BOARDLIST* bl)
+{
+    BOARD* brd;
+    bool first = true;
+    utstring_bincpy(rec, "[", 1);
+    DL_FOREACH(bl->vektor, brd) {
+        if (first == false) {
+            utstring_bincpy(rec, ",", 1);
+        }
+
+        writeJsonMove(brd);
+        first = false;
+    }
+    utstring_bincpy(rec, "]", 1);
+    return;
+}
+
+static void writeBinList(BOARDLIST*);
+
+static void writeBinMove(BOARD* brd)
+{
+    putByte(brd->from);
+    putByte(brd->to);
+    putByte(brd->mover | (brd->promotion << 3) | (brd->captured << 6)
+            | (brd->check << 7));
+    putByte((unsigned char) brd->tag);
+    putByte(brd->ep | ((brd->threat != NULL) << 1) | (brd->ply << 4));
+    putString(brd->qualifier);
+
+    if (brd->threat != NULL) {
+        writeBinList(brd->threat);
+    }
+
+    writeBinList(brd->nextply);
+    return;
+}
+
+static void writeBinList(BOARDLIST* bl)
+{
+    BOARD* brd;
+    unsigned int count = 0;
+
+    if (bl != NULL) {
+        DL_COUNT(bl->vektor, brd, count);
+    }
+
+    putVarint(count);
+
+    if (count > 0) {
+        DL_FOREACH(bl->vektor, brd) {
+            writeBinMove(brd);
+        }
+    }
+
+    return;
+}
+
+static void writeJsonSection(const char* key, BOARDLIST* bl)
+{
+    if (bl != NULL) {
+        utstring_printf(rec, ",\"%s\":", key);
+        writeJsonList(bl);
+    }
+
+    return;
+}
+
+static void writeJsonOptions(void)
+{
+    utstring_printf(rec, ",\"options\":{\"sols\":%u,\"refuts\":%u", opt_sols,
+                    opt_refuts);
+    utstring_printf(rec, ",\"set\":%s", (opt_set == true) ? "true" : "false");
+    utstring_printf(rec, ",\"tries\":%s", (opt_tries == true) ? "true" : "false");
+    utstring_printf(rec, ",\"trivialtries\":%s",
+                    (opt_trivialtries == true) ? "true" : "false");
+    utstring_printf(rec, ",\"actual\":%s", (opt_actual == true) ? "true" : "false");
+    utstring_printf(rec, ",\"threats\":\"%s\"", threats_names[opt_threats]);
+    utstring_printf(rec, ",\"fleck\":%s", (opt_fleck == true) ? "true" : "false");
+    utstring_printf(rec, ",\"shortvars\":%s",
+                    (opt_shortvars == true) ? "true" : "false");
+    utstring_bincpy(rec, "}", 1);
+    return;
+}
+
+/*
+ * Opens the record for a solved directmate and writes everything up to
+ * the classification, which class_direct_2() adds through the rec_class
+ * functions before end_record() closes it.
+ */
+void start_record(DIR_SOL* dsol)
+{
+    char text[200];
+    utstring_new(rec);
+    class_depth = 0;
+    (void) sprintf(text, "%s (v. %s, %s)", PROGRAM_NAME, PROGRAM_VERSION,
+                   PROGRAM_YEAR);
+
+    if (opt_output == OUT_BIN) {
+        putByte(2);
+        putString(text);
+        (void) sprintf(text, "%s:%s:%s", opt_kings, opt_gbr, opt_pos);
+        putString(text);
+        putByte(opt_stip);
+        putByte(opt_aim);
+        putByte(opt_moves);
+        putByte(sound);
+        putByte(dsol->degraded);
+        putString(opt_castling);
+        putString(opt_ep);
+        writeBinList(dsol->set);
+        writeBinList(dsol->tries);
+        writeBinList(dsol->keys);
+        writeBinList(dsol->unresolved);
+        return;
+    }
+
+    utstring_bincpy(rec, "{", 1);
+    putJsonKey("program");
+    putJsonString(text);
+    (void) sprintf(text, "%s:%s:%s", opt_kings, opt_gbr, opt_pos);
+    utstring_bincpy(rec, ",", 1);
+    putJsonKey("diagram");
+    putJsonString(text);
+    (void) sprintf(text, "%s%s", (opt_stip == HELP) ? "H" : (opt_stip == SELF) ? "S"
+                   : (opt_stip == REFLEX) ? "R" : "", (opt_aim == MATE) ? "#" : "=");
+    utstring_printf(rec, ",\"stip\":\"%s\",\"moves\":%u", text, opt_moves);
+
+    if (opt_castling != NULL) {
+        utstring_bincpy(rec, ",", 1);
+        putJsonKey("castling");
+        putJsonString(opt_castling);
+    }
+
+    if (opt_ep != NULL) {
+        utstring_bincpy(rec, ",", 1);
+        putJsonKey("ep");
+        putJsonString(opt_ep);
+    }
+
+    utstring_printf(rec, ",\"soundness\":\"%s\"", soundness_names[sound]);
+
+    if (dsol->degraded == true) {
+        utstring_printf(rec, ",\"degraded\":true");
+    }
+
+    if (opt_meson == false) {
+        writeJsonOptions();
+    }
+
+    writeJsonSection("set", dsol->set);
+    writeJsonSection("tries", dsol->tries);
+    writeJsonSection("keys", dsol->keys);
+    writeJsonSection("unresolved", dsol->unresolved);
+    return;
+}
+
+static bool isClassArray(const char* name)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(class_arrays) / sizeof(class_arrays[0]); i++) {
+        if (strcmp(name, class_arrays[i]) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Starts a JSON member for a classification element. Runs of a repeated
+ * element share one array, which is closed when a sibling of another name
+ * or the end of the parent arrives.
+ */
+static void classMember(const char* name)
+{
+    const char* open = class_array[class_depth];
+
+    if ((open != NULL) && (strcmp(open, name) == 0)) {
+        utstring_bincpy(rec, ",", 1);
+        return;
+    }
+
+    if (open != NULL) {
+        utstring_bincpy(rec, "]", 1);
+        class_array[class_depth] = NULL;
+    }
+
+    if (class_first[class_depth] == false) {
+        utstring_bincpy(rec, ",", 1);
+    }
+
+    class_first[class_depth] = false;
+    putJsonKey(name);
+
+    if (isClassArray(name) == true) {
+        utstring_bincpy(rec, "[", 1);
+        class_array[class_depth] = name;
+    }
+
+    return;
+}
+
+void rec_class_start(const char* name)
+{
+    if (opt_output == OUT_BIN) {
+        putByte(EV_START);
+        putString(name);
+        return;
+    }
+
+    assert(class_depth < CLASS_DEPTH - 1);
+
+    if (class_depth == 0) {
+        // The top level is the record itself, which is never empty here.
+        class_first[0] = false;
+        class_array[0] = NULL;
+    }
+
+    classMember(name);
+    utstring_bincpy(rec, "{", 1);
+    class_depth++;
+    class_first[class_depth] = true;
+    class_array[class_depth] = NULL;
+    return;
+}
+
+void rec_class_text(const char* name, const char* text)
+{
+    if (opt_output == OUT_BIN) {
+        putByte(EV_TEXT);
+        putString(name);
+        putString(text);
+        return;
+    }
+
+    classMember(name);
+    putJsonString(text);
+    return;
+}
+
+void rec_class_int(const char* name, int value)
+{
+    if (opt_output == OUT_BIN) {
+        putByte(EV_INT);
+        putString(name);
+        putVarint(((uint64_t) value << 1) ^ (uint64_t)(int64_t)(value >> 31));
+        return;
+    }
+
+    classMember(name);
+    utstring_printf(rec, "%d", value);
+    return;
+}
+
+void rec_class_end(void)
+{
+    if (opt_output == OUT_BIN) {
+        putByte(EV_END);
+        return;
+    }
+
+    assert(class_depth > 0);
+
+    if (class_array[class_depth] != NULL) {
+        utstring_bincpy(rec, "]", 1);
+    }
+
+    class_depth--;
+    utstring_bincpy(rec, "}", 1);
+    return;
+}
+
+static void writeBinStats(DIR_SOL* dsol, double run_time)
+{
+    unsigned int ply;
+
+    putVarint(dsol->hash_added);
+    putVarint(dsol->hash_hit_null);
+    putVarint(dsol->hash_hit_list);
+    putVarint(STATS_PLIES);
+
+    for (ply = 0; ply < STATS_PLIES; ply++) {
+        putVarint(stats.nodes[WHITE][ply]);
+        putVarint(stats.nodes[BLACK][ply]);
+    }
+
+    putVarint(stats.moves_generated);
+    putVarint(stats.attacks_calls);
+    putVarint(stats.mate_tests);
+    putVarint(stats.tt_probes);
+    putVarint(stats.tt_hits);
+    putVarint(stats.tt_stores);
+    putVarint(stats.tt_replacements);
+    putVarint(stats.killer_hits);
+    putVarint(stats.threat_hits);
+    putVarint(stats.mem_peak);
+    putVarint((uint64_t)(run_time * 1e6));
+    return;
+}
+
+void end_record(DIR_SOL* dsol, double run_time)
+{
+    if (opt_output == OUT_BIN) {
+        UT_string* len;
+        putByte(EV_DONE);
+        putByte(opt_meson == false);
+
+        if (opt_meson == false) {
+            writeBinStats(dsol, run_time);
+        }
+
+        // The length prefix goes in front of the finished payload.
+        len = rec;
+        utstring_new(rec);
+        putVarint(utstring_len(len));
+        utstring_concat(rec, len);
+        utstring_free(len);
+    } else {
+        if (opt_meson == false) {
+            utstring_printf(rec, ",\"stats\":");
+            stats_json(rec, dsol->hash_hit_null, dsol->hash_hit_list);
+            utstring_printf(rec, ",\"time\":%f", run_time);
+        }
+
+        utstring_bincpy(rec, "}\n", 2);
+    }
+
+    if (fwrite(utstring_body(rec), 1, utstring_len(rec), stdout) != utstring_len(rec)) {
+        (void) fputs("sengine ERROR: cannot write the output record\n", stderr);
+        exit(1);
+    }
+
+    utstring_free(rec);
+    rec = NULL;
+    return;
+}
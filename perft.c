@@ -0,0 +1,114 @@
+/*
+ *	perft.c
+ *	(c) 2020, Brian Stephenson
+ *	brian@bstephen.me.uk
+ *
+ *	A program to test orthodox chess problems of the types:
+ *
+ *		directmates
+ *		selfmates
+ *		relfexmates
+ *		helpmates
+ *
+ *	Input is taken from the program options and output is xml on stdout.
+ *
+ *	This is the module for --perft and --divide. It counts the leaf nodes
+ *	of the full move tree from the diagram, using the same generators as
+ *	the solver, so move generation can be checked and timed on its own.
+ */
+
+#include "sengine.h"
+
+extern unsigned int opt_perft;
+extern bool opt_divide;
+
+static const char promArray[] = "  nbrq";
+
+static BOARDLIST* generateMoves(BOARD* b, int ply)
+{
+    unsigned int flights;
+
+    if (b->side == BLACK) {
+        return generateWhiteBoardlist(b, ply);
+    }
+
+    return generateBlackBoardlist(b, ply, &flights);
+}
+
+static uint64_t perft(BOARD* b, unsigned int depth, int ply)
+{
+    BOARDLIST* bl = generateMoves(b, ply);
+    BOARD* nb;
+    uint64_t count = 0;
+
+    if (depth == 1) {
+        DL_FOREACH(bl->vektor, nb) {
+            count++;
+        }
+    } else {
+        DL_FOREACH(bl->vektor, nb) {
+            count += perft(nb, depth - 1, ply + 1);
+        }
+    }
+
+    freeBoardlist(bl);
+    return count;
+}
+
+static void moveStr(BOARD* b, char* s)
+{
+    s[0] = 'a' + FILE(b->from);
+    s[1] = '1' + RANK(b->from);
+
+    // An ep capture is recorded against the captured pawn's square.
+    if (b->ep == true) {
+        s[2] = 'a' + FILE(b->to);
+        s[3] = '1' + RANK(b->to) + ((b->side == WHITE) ? 1 : -1);
+    } else {
+        s[2] = 'a' + FILE(b->to);
+        s[3] = '1' + RANK(b->to);
+    }
+
+    s[4] = promArray[b->promotion];
+    s[5] = '\0';
+
+    if (s[4] == ' ') {
+        s[4] = '\0';
+    }
+
+    return;
+}
+
+void do_perft(BOARD* init_pos)
+{
+    struct timespec start, end;
+    double secs;
+    uint64_t total = 0;
+    (void) clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (opt_divide == true) {
+        BOARDLIST* bl = generateMoves(init_pos, 1);
+        BOARD* b;
+        char mv[6];
+
+        DL_FOREACH(bl->vektor, b) {
+            uint64_t count = (opt_perft == 1) ? 1 : perft(b, opt_perft - 1, 2);
+            moveStr(b, mv);
+            (void) printf("%s: %" PRIu64 "\n", mv, count);
+            total += count;
+        }
+
+        freeBoardlist(bl);
+        (void) putchar('\n');
+    } else {
+        total = perft(init_pos, opt_perft, 1);
+    }
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &end);
+    secs = (double)(end.tv_sec - start.tv_sec)
+           + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    (void) printf("perft(%u) = %" PRIu64 "\n", opt_perft, total);
+    (void) printf("time = %.3f s, nodes/sec = %.0f\n", secs,
+                  (secs > 0.0) ? (double) total / secs : 0.0);
+    return;
+}
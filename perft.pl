@@ -0,0 +1,59 @@
+#!/usr/bin/perl
+#	perft.pl
+#	(c) 2020, B D Stephenson
+#	brian@bstephen.me.uk
+#
+#	Runs the perft suite in bench/perft.txt through 'sengine --perft' and
+#	checks each leaf count, reporting the generator speed as it goes.
+#
+#	perl perft.pl [engine]
+
+use warnings;
+use English '-no_match_vars';
+use strict;
+
+my $SUITE     = 'bench/perft.txt';
+my $PROG_NAME = 'perft.pl';
+
+our $VERSION = 1.0;
+
+my $engine = $ARGV[0] || './sengine143';
+
+exit main();
+
+sub main {
+    my $fails = 0;
+
+    open my $fh, '<', $SUITE or die "$PROG_NAME: cannot open $SUITE\n";
+
+    printf "%-10s %5s %12s %12s  %s\n", 'position', 'depth', 'nodes',
+      'nodes/sec', 'verdict';
+
+    while ( my $line = <$fh> ) {
+        chomp $line;
+        next if ( $line =~ m/^\s*(\#|$)/xms );
+        my ( $name, $kings, $gbr, $pos, $castling, $depth, $expected ) =
+          split /\s+/xms, $line;
+        my @cmd = (
+            $engine, "--kings=$kings", "--gbr=$gbr", "--pos=$pos",
+            "--perft=$depth"
+        );
+        push @cmd, "--castling=$castling" if ( $castling ne q{-} );
+        my $out = qx{@cmd};
+        my ($nodes) = $out =~ m/^perft\(\d+\)\s=\s(\d+)$/xms;
+        my ($nps)   = $out =~ m{nodes/sec\s=\s(\d+)}xms;
+        my $ok = ( defined $nodes && $nodes == $expected );
+
+        printf "%-10s %5d %12s %12s  %s\n", $name, $depth,
+          ( defined $nodes ? $nodes : 'FAILED' ), ( $nps || 0 ),
+          ( $ok ? 'ok' : "expected $expected" );
+        $fails++ if ( !$ok );
+    }
+
+    close $fh or die "$PROG_NAME: cannot close $SUITE\n";
+
+    print "\n$PROG_NAME: "
+      . ( $fails == 0 ? 'all counts correct' : "$fails count(s) wrong" ) . "\n";
+
+    return ( $fails == 0 ) ? 0 : 1;
+}
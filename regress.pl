@@ -0,0 +1,148 @@
+#!/usr/bin/perl
+#	regress.pl
+#	(c) 2020, B D Stephenson
+#	brian@bstephen.me.uk
+#
+#	Runs the problems in bench/regress.txt through sengine and checks that
+#	each solution is exactly the one recorded, as the MD5 of the output
+#	with the timing, statistics and build details left out.
+#
+#	A 'resume' line names a problem above it and a node limit. The problem
+#	is solved again from a full checkpoint and from one cut short by the
+#	limit, and both outputs must match its own byte for byte. A 'merge'
+#	line names a problem and a number of shards, each searched with
+#	--shard, whose checkpoints merged must give that output as well.
+#
+#	perl regress.pl [--update] [engine]
+#
+#	--update rewrites the recorded digests from this run instead of
+#	comparing, for a change that is meant to alter the output.
+
+use warnings;
+use English '-no_match_vars';
+use strict;
+use Digest::MD5 qw(md5_hex);
+use File::Temp qw(tempdir);
+
+my $SUITE     = 'bench/regress.txt';
+my $PROG_NAME = 'regress.pl';
+
+our $VERSION = 1.0;
+
+my $update = 0;
+my %problems;
+my $engine = './sengine143';
+
+foreach my $arg (@ARGV) {
+    if ( $arg eq '--update' ) {
+        $update = 1;
+    }
+    else {
+        $engine = $arg;
+    }
+}
+
+exit main();
+
+sub main {
+    my $fails = 0;
+    my @lines;
+
+    open my $fh, '<', $SUITE or die "$PROG_NAME: cannot open $SUITE\n";
+
+    printf "%-8s %-32s  %s\n", 'problem', 'digest', 'verdict';
+
+    while ( my $line = <$fh> ) {
+        chomp $line;
+
+        if ( $line =~ m/^\s*(\#|$)/xms ) {
+            push @lines, $line;
+            next;
+        }
+
+        push @lines, $line;
+
+        if ( $line =~ m/^(resume|merge)\s/xms ) {
+            my ( $check, $name, $n ) = split /\s+/xms, $line;
+            my $ok =
+              ( $check eq 'resume' ) ? resume( $name, $n ) : merge( $name, $n );
+
+            printf "%-8s %-32s  %s\n", $check, $name,
+              ( $ok ? 'ok' : 'differs from a single run' );
+            $fails++ if ( !$ok );
+            next;
+        }
+
+        my ( $name, $expected, $kings, $gbr, $pos, @opts ) =
+          split /\s+/xms, $line;
+        my $out    = solve( $kings, $gbr, $pos, @opts );
+        my $digest = md5_hex($out);
+        my $ok     = ( $digest eq $expected );
+
+        printf "%-8s %-32s  %s\n", $name, $digest,
+          ( ( $ok || $update ) ? 'ok' : "expected $expected" );
+        $fails++ if ( !$ok && !$update );
+        $lines[-1] =~ s/\Q$expected\E/$digest/xms;
+        $problems{$name} = [ $out, $kings, $gbr, $pos, @opts ];
+    }
+
+    close $fh or die "$PROG_NAME: cannot close $SUITE\n";
+
+    if ($update) {
+        open my $out, '>', $SUITE or die "$PROG_NAME: cannot write $SUITE\n";
+        print {$out} map { "$_\n" } @lines;
+        close $out or die "$PROG_NAME: cannot close $SUITE\n";
+    }
+
+    print "\n$PROG_NAME: "
+      . ( $fails == 0 ? 'all solutions unchanged' : "$fails solution(s) changed" )
+      . "\n";
+
+    return ( $fails == 0 ) ? 0 : 1;
+}
+
+sub solve {
+    my ( $kings, $gbr, $pos, @opts ) = @_;
+    my @cmd =
+      ( $engine, "--kings=$kings", "--gbr=$gbr", "--pos=$pos", @opts );
+    my $out = qx{@cmd 2>/dev/null};
+
+    $out =~ s{<stats>.*?</stats>}{}xmsg;
+    $out =~ s{<SolvingTime>.*?</SolvingTime>}{}xmsg;
+    $out =~ s{<compiler>.*?</platform>}{}xmsg;
+
+    return $out;
+}
+
+sub problem {
+    my ($name) = @_;
+    my $problem = $problems{$name}
+      or die "$PROG_NAME: no problem $name before the line naming it\n";
+
+    return @{$problem};
+}
+
+sub resume {
+    my ( $name, $limit ) = @_;
+    my ( $single, @args ) = problem($name);
+    my $dir = tempdir( CLEANUP => 1 );
+
+    solve( @args, "--checkpoint=$dir/full.cp" );
+    solve( @args, "--checkpoint=$dir/part.cp", "--nodelimit=$limit" );
+
+    return ( solve( @args, "--resume=$dir/full.cp" ) eq $single )
+      && ( solve( @args, "--resume=$dir/part.cp" ) eq $single );
+}
+
+sub merge {
+    my ( $name, $shards ) = @_;
+    my ( $single, @args ) = problem($name);
+    my $dir = tempdir( CLEANUP => 1 );
+    my @files = map { "$dir/$_.cp" } 1 .. $shards;
+
+    foreach my $i ( 1 .. $shards ) {
+        solve( @args, "--shard=$i/$shards", "--checkpoint=$files[$i - 1]" );
+    }
+
+    return solve( @args, '--merge=' . join q{,}, @files ) eq $single;
+}
@@ -0,0 +1,578 @@
+/*
+ *	self.c
+ *	(c) 2020, Brian Stephenson
+ *	brian@bstephen.me.uk
+ *
+ *	A program to test orthodox chess problems of the types:
+ *
+ *		directmates
+ *		selfmates
+ *		relfexmates
+ *		helpmates
+ *
+ *	Input is taken from the program options and output is xml on stdout.
+ *
+ *	This is the module for solving selfmates and selfstalemates. White
+ *	plays first and must force Black to mate (or stalemate) him within the
+ *	moves, whatever Black plays. A black move that mates sooner ends its
+ *	variation there.
+ *
+ *	The search is laid out as solve_direct()'s is. Black's replies to
+ *	White's last move are settled by forcedGoal(), which walks Black's
+ *	moves without building any boards and stops at the first one that does
+ *	not mate, so the widest ply of the tree costs little. The positions
+ *	White cannot force the goal from are kept in a transposition table,
+ *	with the most moves left he has failed with.
+ *
+ *	Reflexmates and reflexstalemates are solved by the same search, with
+ *	either side bound to reach the goal at once when it can, which
+ *	goalInOne() tells. White's answer is kept in the transposition table
+ *	beside the moves left he fails with, under the one key; Black's is
+ *	found once, when White's moves are looked over for short solutions,
+ *	and handed on to the search of his replies.
+ */
+
+#include "sengine.h"
+
+extern unsigned int opt_moves;
+extern bool opt_tries;
+extern bool opt_actual;
+extern unsigned int opt_sols;
+extern bool opt_trivialtries;
+extern enum SOUNDNESS sound;
+extern enum AIM opt_aim;
+extern unsigned int opt_refuts;
+extern bool opt_shortvars;
+extern int opt_hash;
+extern char* opt_twins;
+
+void setup_mpool();
+void destroy_mpool();
+void freeHashValue(HASHVALUE*);
+void qualifyMove(BOARDLIST*, BOARD*);
+
+static BOARDLIST* blackMove(BOARD*, int, bool);
+static BOARDLIST* whiteMove(BOARD*, int);
+
+static bool reflex = false;
+static unsigned int self_moves = 0;
+static unsigned int refuts_allowed = 0;
+static HASHVALUE* transtable = NULL;
+static unsigned int tt_size = 0;
+static unsigned int hash_added = 0;
+static unsigned int hash_hit_null = 0;
+static bool tt_live = false;
+
+static void countNode(BOARD* b)
+{
+    stats.nodes[b->side][(b->ply < STATS_PLIES) ? b->ply : STATS_PLIES - 1]++;
+    return;
+}
+
+static char goalTag(void)
+{
+    return (opt_aim == MATE) ? '#' : '=';
+}
+
+static BOARDLIST* refuted(BOARDLIST* bl)
+{
+    bl->minStip = NOSTIP;
+    bl->maxStip = NOSTIP;
+    bl->stipIn = NOSTIP;
+    return bl;
+}
+
+static void dropPosition(BOARD* b)
+{
+    if (b->pos != NULL) {
+        freePosition(b->pos);
+        b->pos = NULL;
+    }
+
+    return;
+}
+
+/*
+ * Whether Black's move b mates White, or stalemates him.
+ */
+static bool blackGoal(BOARD* b)
+{
+    if (b->check != (opt_aim == MATE)) {
+        return false;
+    }
+
+    stats.mate_tests++;
+    return hasLegalMove(b->pos, b->epSquare, b->check, WHITE) == false;
+}
+
+/*
+ * Black's replies to White's move w that reach the goal: all of them when
+ * forcedGoal() has been asked, and for a reflexmate the ones Black is
+ * bound to play.
+ */
+static BOARDLIST* goalReplies(BOARD* w, int move)
+{
+    BOARDLIST* bml;
+    BOARD* b;
+    BOARD* tmp;
+    unsigned int flights;
+    bml = generateBlackBoardlist(w, move, &flights);
+    DL_FOREACH_SAFE(bml->vektor, b, tmp) {
+        countNode(b);
+        qualifyMove(bml, b);
+
+        if ((reflex == true) && (blackGoal(b) == false)) {
+            DL_DELETE(bml->vektor, b);
+            freeBoard(b);
+            continue;
+        }
+
+        b->tag = goalTag();
+        dropPosition(b);
+    }
+    bml->minStip = (unsigned char) move;
+    bml->maxStip = (unsigned char) move;
+    bml->stipIn = (unsigned char) move;
+    return bml;
+}
+
+static void clearTransTable(void)
+{
+    HASHVALUE* cu;
+    HASHVALUE* tmp;
+    HASH_ITER(hh, transtable, cu, tmp) {
+        HASH_DEL(transtable, cu);
+        freeHashValue(cu);
+    }
+    tt_size = 0;
+    return;
+}
+
+static HASHVALUE* newEntry(HASHKEY* kp, bool goal)
+{
+    HASHVALUE* hv;
+
+    if (memoryPressure() != MEM_OK) {
+        return NULL;
+    }
+
+    // A full table is emptied, as the directmate search does.
+    if (tt_size >= (unsigned int) opt_hash) {
+        stats.tt_replacements += tt_size;
+        clearTransTable();
+    }
+
+    hv = getHashValue();
+    hv->sym = kp->sym;
+    hv->goal = goal;
+    hv->fails = 0;
+    hv->cont = NULL;
+    (void) memcpy((void*) hv->hashkey, (void*) & (kp->hashkey), MD5_LEN);
+    HASH_ADD(hh, transtable, hashkey, MD5_LEN, hv);
+    tt_size++;
+    hash_added++;
+    stats.tt_stores++;
+    return hv;
+}
+
+/*
+ * Records that White fails with left moves left, and so with fewer. The
+ * entry is looked for again, as the search below may have emptied the
+ * table.
+ */
+static void storeFailure(HASHKEY* kp, unsigned char left)
+{
+    HASHVALUE* hv;
+    HASH_FIND(hh, transtable, kp->hashkey, MD5_LEN, hv);
+
+    if (hv == NULL) {
+        hv = newEntry(kp, false);
+    }
+
+    if (hv != NULL) {
+        hv->fails = left;
+    }
+
+    return;
+}
+
+/*
+ * Black's replies to White's move-th move w. Only on the first move may
+ * up to refuts_allowed of them escape, which makes w a try. In a
+ * reflexmate, tested says Black has been found to have no goal at once.
+ */
+static BOARDLIST* blackMove(BOARD* w, int move, bool tested)
+{
+    BOARDLIST* bml;
+    BOARDLIST* wml;
+    BOARD* b;
+    BOARD* tmp;
+    unsigned int flights;
+    unsigned int refuts = 0;
+    unsigned int allowed = (move == 1) ? refuts_allowed : 0;
+    unsigned char minStip = NOSTIP;
+    unsigned char maxStip = 0;
+    unsigned char stip;
+    int ct;
+
+    if (reflex == true) {
+        if ((tested == false) && (goalInOne(w, BLACK, opt_aim) == true)) {
+            return goalReplies(w, move);
+        }
+
+        if (move == (int) self_moves) {
+            return refuted(getBoardlist(BLACK, (unsigned char) move));
+        }
+    } else if ((move == (int) self_moves) && (allowed == 0)) {
+        if (forcedGoal(w, BLACK, opt_aim) == true) {
+            return goalReplies(w, move);
+        }
+
+        return refuted(getBoardlist(BLACK, (unsigned char) move));
+    }
+
+    bml = generateBlackBoardlist(w, move, &flights);
+    DL_COUNT(bml->vektor, tmp, ct);
+
+    if (ct == 0) {
+        // White has mated or stalemated Black himself.
+        return refuted(bml);
+    }
+
+    DL_FOREACH(bml->vektor, b) {
+        countNode(b);
+        qualifyMove(bml, b);
+
+        // Black is known not to reach the goal in a reflexmate.
+        if ((reflex == false) && (blackGoal(b) == true)) {
+            b->tag = goalTag();
+            stip = (unsigned char) move;
+        } else if (move == (int) self_moves) {
+            stip = NOSTIP;
+        } else {
+            wml = whiteMove(b, move + 1);
+            stip = wml->stipIn;
+
+            if (stip == NOSTIP) {
+                freeBoardlist(wml);
+            } else {
+                b->nextply = wml;
+            }
+        }
+
+        dropPosition(b);
+
+        if (stip == NOSTIP) {
+            if (++refuts > allowed) {
+                break;
+            }
+
+            b->tag = '!';
+        } else {
+            minStip = (stip < minStip) ? stip : minStip;
+            maxStip = (stip > maxStip) ? stip : maxStip;
+        }
+    }
+
+    if ((refuts > allowed) || (minStip == NOSTIP)) {
+        return refuted(bml);
+    }
+
+    bml->minStip = minStip;
+    bml->maxStip = maxStip;
+    bml->stipIn = maxStip;
+    bml->isTry = (refuts > 0);
+
+    if ((opt_shortvars == false) && (minStip != maxStip)) {
+        weedOutShortVars(bml, maxStip);
+    }
+
+    return bml;
+}
+
+/*
+ * White's move-th moves after Black's move b, those that force the goal
+ * soonest. A move after which Black must reach the goal at once is looked
+ * for first, as the directmate search looks for mates.
+ */
+static BOARDLIST* whiteMove(BOARD* b, int move)
+{
+    BOARDLIST* wml;
+    BOARDLIST* bml;
+    BOARDLIST* uml;
+    BOARD* w;
+    BOARD* tmp;
+    HASHKEY kp;
+    HASHVALUE* ptr = NULL;
+    unsigned char left = (unsigned char)(self_moves - move + 1);
+    unsigned char minStip = NOSTIP;
+    unsigned char maxStip = 0;
+    bool shortAchieved = false;
+    bool ishash = (b->epSquare == 0)
+                  && ((reflex == true) || (move < (int) self_moves));
+
+    if (ishash == true) {
+        getHashKey(b, 0, &kp);
+        HASH_FIND(hh, transtable, &kp, MD5_LEN, ptr);
+        stats.tt_probes++;
+
+        if (ptr != NULL) {
+            stats.tt_hits++;
+
+            if ((ptr->goal == true) || (ptr->fails >= left)) {
+                hash_hit_null++;
+                return refuted(getBoardlist(WHITE, (unsigned char) move));
+            }
+        }
+    }
+
+    // White bound to reach the goal himself has lost.
+    if ((reflex == true) && (ptr == NULL)) {
+        bool goal = goalInOne(b, WHITE, opt_aim);
+
+        if (ishash == true) {
+            (void) newEntry(&kp, goal);
+        }
+
+        if (goal == true) {
+            return refuted(getBoardlist(WHITE, (unsigned char) move));
+        }
+    }
+
+    wml = generateWhiteBoardlist(b, move);
+    DL_FOREACH(wml->vektor, w) {
+        countNode(w);
+
+        if (((reflex == true) ? goalInOne(w, BLACK, opt_aim)
+                : forcedGoal(w, BLACK, opt_aim)) == true) {
+            w->nextply = goalReplies(w, move);
+            shortAchieved = true;
+        }
+    }
+
+    if ((shortAchieved == true) || (move == (int) self_moves)) {
+        DL_FOREACH_SAFE(wml->vektor, w, tmp) {
+            if (w->nextply == NULL) {
+                DL_DELETE(wml->vektor, w);
+                freeBoard(w);
+            }
+        }
+        minStip = (shortAchieved == true) ? (unsigned char) move : NOSTIP;
+        maxStip = minStip;
+    } else {
+        DL_FOREACH_SAFE(wml->vektor, w, tmp) {
+            if (shortAchieved == true) {
+                DL_DELETE(wml->vektor, w);
+                freeBoard(w);
+                continue;
+            }
+
+            // What is left has been found to have no goal at once.
+            bml = blackMove(w, move, reflex);
+
+            if (bml->stipIn == NOSTIP) {
+                DL_DELETE(wml->vektor, w);
+                freeBoard(w);
+                freeBoardlist(bml);
+            } else {
+                w->nextply = bml;
+                dropPosition(w);
+                minStip = (bml->stipIn < minStip) ? bml->stipIn : minStip;
+                maxStip = (bml->stipIn > maxStip) ? bml->stipIn : maxStip;
+                shortAchieved = (minStip == (unsigned char)(move + 1));
+            }
+        }
+    }
+
+    if (minStip == NOSTIP) {
+        if (ishash == true) {
+            storeFailure(&kp, left);
+        }
+
+        return refuted(wml);
+    }
+
+    wml->minStip = minStip;
+    wml->maxStip = maxStip;
+    wml->stipIn = minStip;
+
+    if (minStip != maxStip) {
+        weedOutLongVars(wml);
+    }
+
+    uml = generateWhiteBoardlist(b, move);
+    DL_FOREACH(wml->vektor, w) {
+        dropPosition(w);
+        qualifyMove(uml, w);
+    }
+    freeBoardlist(uml);
+    return wml;
+}
+
+/*
+ * White's first moves, each tagged '!' as a key or '?' as a try.
+ */
+static BOARDLIST* firstMove(BOARD* brd)
+{
+    BOARDLIST* wml;
+    BOARDLIST* bml;
+    BOARDLIST* uml;
+    BOARD* b;
+    BOARD* tmp;
+
+    if ((reflex == true) && (goalInOne(brd, WHITE, opt_aim) == true)) {
+        return getBoardlist(WHITE, 1);
+    }
+
+    wml = generateWhiteBoardlist(brd, 1);
+    DL_FOREACH_SAFE(wml->vektor, b, tmp) {
+        countNode(b);
+        bml = blackMove(b, 1, false);
+
+        if (bml->stipIn == NOSTIP) {
+            freeBoardlist(bml);
+            DL_DELETE(wml->vektor, b);
+            freeBoard(b);
+        } else {
+            if (bml->isTry == true) {
+                b->tag = '?';
+                putRefutsToEnd(bml);
+            } else {
+                b->tag = '!';
+            }
+
+            b->nextply = bml;
+            dropPosition(b);
+        }
+    }
+    uml = generateWhiteBoardlist(brd, 1);
+    DL_FOREACH(wml->vektor, b) {
+        qualifyMove(uml, b);
+    }
+    freeBoardlist(uml);
+    return wml;
+}
+
+static void deTrivialise(BOARDLIST* wml)
+{
+    BOARD* wm;
+    BOARD* tmp;
+    BOARD* tmp1;
+    int ct;
+    DL_FOREACH_SAFE(wml->vektor, wm, tmp) {
+        DL_COUNT(wm->nextply->vektor, tmp1, ct);
+
+        if (ct < 2) {
+            DL_DELETE(wml->vektor, wm);
+            freeBoard(wm);
+        }
+    }
+    return;
+}
+
+static void solve(DIR_SOL* dsol, BOARD* startpos)
+{
+    BOARDLIST* wml;
+    BOARD* b;
+    BOARD* tmp;
+    int ct;
+    sound = UNSET;
+    hash_added = 0;
+    hash_hit_null = 0;
+
+    if (tt_live == false) {
+        setup_mpool();
+        tt_live = true;
+    }
+
+    if (opt_actual == true) {
+        start_phase(PH_GLOSS);
+        refuts_allowed = 0;
+
+        for (self_moves = 1; self_moves < opt_moves; self_moves++) {
+            wml = firstMove(startpos);
+            DL_COUNT(wml->vektor, b, ct);
+
+            if (ct > 0) {
+                dsol->keys = wml;
+                sound = SHORT_SOLUTION;
+                break;
+            }
+
+            freeBoardlist(wml);
+        }
+
+        end_phase(PH_GLOSS);
+    }
+
+    if (sound == UNSET) {
+        start_phase(PH_TRIESKEYS);
+        self_moves = opt_moves;
+        refuts_allowed = opt_refuts;
+        dsol->trieskeys = firstMove(startpos);
+        dsol->keys = getBoardlist(WHITE, 1);
+        dsol->tries = getBoardlist(WHITE, 1);
+        DL_FOREACH_SAFE(dsol->trieskeys->vektor, b, tmp) {
+            DL_DELETE(dsol->trieskeys->vektor, b);
+
+            if (isKey(b) == true) {
+                DL_APPEND(dsol->keys->vektor, b);
+            } else {
+                DL_APPEND(dsol->tries->vektor, b);
+            }
+        }
+        freeBoardlist(dsol->trieskeys);
+        dsol->trieskeys = NULL;
+        end_phase(PH_TRIESKEYS);
+
+        if ((opt_tries == true) && (opt_trivialtries == false)) {
+            deTrivialise(dsol->tries);
+        }
+
+        DL_COUNT(dsol->keys->vektor, b, ct);
+
+        if (ct == 0) {
+            sound = NO_SOLUTION;
+        } else if (ct < (int) opt_sols) {
+            sound = MISSING_SOLUTION;
+        } else if (ct == (int) opt_sols) {
+            sound = SOUND;
+        } else {
+            sound = COOKED;
+        }
+    }
+
+    // Twins share the transposition table.
+    if (opt_twins == NULL) {
+        end_self();
+    }
+
+    dsol->hash_added = hash_added;
+    dsol->hash_hit_null = hash_hit_null;
+    return;
+}
+
+void end_self(void)
+{
+    if (tt_live == true) {
+        clearTransTable();
+        destroy_mpool();
+        tt_live = false;
+    }
+
+    return;
+}
+
+void solve_self(DIR_SOL* dsol, BOARD* startpos)
+{
+    reflex = false;
+    solve(dsol, startpos);
+    return;
+}
+
+void solve_reflex(DIR_SOL* dsol, BOARD* startpos)
+{
+    reflex = true;
+    solve(dsol, startpos);
+    return;
+}
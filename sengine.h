@@ -30,14 +30,6 @@
 #include "utstring.h"
 #include "md5.h"
 
-#ifdef MOVESTAT
-#undef uthash_expand_fyi
-#define uthash_expand_fyi(tbl) fprintf(stderr, "expanded to %u buckets\n", tbl->num_buckets)
-
-#undef uthash_noexpand_fyi
-#define uthash_noexpand_fyi(tbl) fprintf(stderr, "warning: bucket expansion inhibited\n")
-#endif
-
 #ifdef __GNUC__
 #define COMP "gcc"
 #define CV  __VERSION__
@@ -69,6 +61,7 @@
 #define MAX_HASH_SIZE 150000
 #define MD5_LEN 16
 #define KILLERKEY_LEN 3
+#define MOVESTR_LEN 16
 #define NOSTIP 100
 #define B_KING_CASTLING 2
 #define B_QUEEN_CASTLING 4
@@ -95,14 +88,16 @@
 
 enum AIM { MATE, STALEMATE };
 enum THREATS { ALL, NONE, SHORTEST };
+enum OUTPUT { OUT_XML, OUT_JSONL, OUT_BIN };
 enum STIP { DIRECT, SELF, REFLEX, HELP };
 enum COLOUR { WHITE, BLACK };
 enum STATUS { SETPLAY, THREATS, TRIESKEYS };
 enum PIECE { NOPIECE = 0, OCCUPIED = 0, PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING
            };
 enum SOUNDNESS { UNSET, SHORT_SOLUTION, SOUND, COOKED, NO_SOLUTION,
-                 MISSING_SOLUTION
+                 MISSING_SOLUTION, RESOURCE_LIMIT, TIMEOUT, PARTIAL
                };
+enum MEMSTATE { MEM_OK, MEM_EVICT, MEM_DROP, MEM_EXHAUSTED };
 
 typedef uint64_t BITBOARD;
 
@@ -127,6 +122,7 @@ typedef struct BOARDLIST {
     unsigned char stipIn;
     unsigned char use_count;
     enum COLOUR toPlay;
+    uint64_t fingerprint;        /* Hash of the moves and their continuations, 0 until taken. */
 } BOARDLIST;
 
 typedef struct BOARD {
@@ -148,6 +144,7 @@ typedef struct BOARD {
     unsigned char flights;
     unsigned char use_count;
     bool killer;
+    uint64_t fingerprint;        /* Hash of this move, its continuations and threats, 0 until taken. */
 	 struct BOARD* prev;
     struct BOARD* next;
 } BOARD;
@@ -178,10 +175,14 @@ typedef struct HASH_VAR {
 
 typedef struct HASHKEY {
     unsigned char hashkey[16];
+    unsigned char sym;           /* Symmetry taking the position to the one hashed. */
 } HASHKEY;
 
 typedef struct HASHVALUE {
     unsigned char hashkey[16];
+    unsigned char sym;           /* As in the HASHKEY the entry was stored under. */
+    bool goal;                   /* Whether the side to move has a goal in one. */
+    unsigned char fails;         /* The most moves left it has failed with. */
     BOARDLIST* cont;
     UT_hash_handle hh;
 } HASHVALUE;
@@ -196,18 +197,54 @@ typedef struct KILLERHASHVALUE {
     UT_hash_handle hh;
 } KILLERHASHVALUE;
 
+#define STATS_PLIES 32
+
+enum PHASE { PH_GLOSS, PH_TRIESKEYS, PH_THREATS, PH_SETPLAY, PH_SETTHREATS,
+             PH_CLASSIFY, PH_XML, PHASES
+           };
+
+typedef struct STATS {
+    uint64_t nodes[2][STATS_PLIES]; /* Positions searched, by side that moved and ply. */
+    uint64_t moves_generated;    /* Moves in full move lists. */
+    uint64_t attacks_calls;
+    uint64_t mate_tests;         /* Checks (or stalemates) tested for a black reply. */
+    uint64_t tt_probes;
+    uint64_t tt_hits;
+    uint64_t tt_sym_hits;        /* Hits stored from a mirrored or rotated position. */
+    uint64_t tt_stores;
+    uint64_t tt_replacements;    /* Entries evicted to stay within --memory. */
+    uint64_t killer_hits;        /* Refutations found by a move marked as a killer. */
+    uint64_t threat_hits;        /* Threat searches answered from the threat table. */
+    uint64_t tb_cutoffs;         /* Subtrees a tablebase showed could not mate in time. */
+    uint64_t intel_cutoffs;      /* Subtrees --intelligent showed could not reach a mate. */
+    uint64_t board_peak;
+    uint64_t position_peak;
+    uint64_t boardlist_peak;
+    uint64_t hashvalue_peak;
+    uint64_t mem_peak;           /* Bytes. */
+    double wall[PHASES];         /* Monotonic seconds spent in each phase. */
+    double cpu[PHASES];          /* CPU seconds spent in each phase. */
+} STATS;
+
+extern __thread STATS stats;
+extern const char* const phase_names[PHASES];
+
 typedef struct DIR_SOL {
     BOARDLIST* set;
     BOARDLIST* tries;
     BOARDLIST* keys;
     BOARDLIST* trieskeys;
+    BOARDLIST* unresolved;       /* First moves not searched to a result, as the search was stopped or the problem was already cooked. */
     unsigned int hash_added;
     unsigned int hash_hit_null;
     unsigned int hash_hit_list;
+    bool degraded;               /* Table entries or positions were dropped to stay within --memory. */
 } DIR_SOL;
 
 typedef struct HELP_SOL {
     BOARDLIST* sols;
+    unsigned int hash_added;
+    unsigned int hash_hit_null;
 } HELP_SOL;
 
 typedef struct SELF_SOL {
@@ -230,30 +267,79 @@ void freeBoardlist(BOARDLIST*);
 ID_BOARD* getIdBoard();
 ID_BOARD* cloneIdBoard(ID_BOARD* inIdBrd);
 void freeIdBoard(ID_BOARD* inIdBrd);
+enum MEMSTATE memoryPressure(void);
+void open_checkpoint(void);
+void close_checkpoint(void);
+bool resumeFirstMove(BOARD*, BOARDLIST**, HASHVALUE**, KILLERHASHVALUE**);
+void checkpointFirstMove(BOARD*, BOARDLIST*, KILLERHASHVALUE*);
+void checkpointEntry(BOARD*, HASHKEY*, BOARDLIST*);
+void checkpointEvicted(void);
+bool cache_lookup(BOARD*);
+void cache_store(bool);
+bool twin_valid(const char*);
+unsigned int twin_count(void);
+int twin_select(unsigned int);
+int tb_probe(POSITION*, enum COLOUR);
+bool intel_unreachable(POSITION*, int, int);
 int do_options(int, char**);
 void init(void);
 BOARD* setup_diagram(enum COLOUR);
 int validate_board(BOARD*);
 void solve_direct(DIR_SOL*, BOARD*);
-void start_dir(void);
+void solve_help(HELP_SOL*, BOARD*);
+void solve_self(DIR_SOL*, BOARD*);
+void solve_reflex(DIR_SOL*, BOARD*);
+void end_direct(void);
+void dropRestoredPosition(BOARD*);
+void end_self(void);
+void do_perft(BOARD*);
+void start_dir(bool);
 void end_dir(void);
 void time_dir(double);
 void add_dir_set(BOARDLIST*);
 void add_dir_tries(BOARDLIST*);
 void add_dir_keys(BOARDLIST*);
+void add_dir_unresolved(BOARDLIST*);
+void add_help_sols(BOARDLIST*);
+void share_dir_lists(DIR_SOL*);
+void xmlStartDoc(FILE*);
+void xmlEndDoc(void);
+void xmlStartElement(const unsigned char*);
+void xmlAddAttribute(const unsigned char*, const char*);
+void xmlAddText(const char*);
+void xmlAddMove(BOARD*);
+void xmlEndElement(void);
 void add_dir_stats(DIR_SOL*);
+void add_help_stats(HELP_SOL*);
+void print_stats_json(FILE*, unsigned int, unsigned int);
+void stats_json(UT_string*, unsigned int, unsigned int);
+void start_record(DIR_SOL*);
+void end_record(DIR_SOL*, double);
+void rec_class_start(const char*);
+void rec_class_text(const char*, const char*);
+void rec_class_int(const char*, int);
+void rec_class_end(void);
+void start_phase(enum PHASE);
+void end_phase(enum PHASE);
 void add_dir_options(void);
-char* toStr(BOARD*);
+char* toStr(BOARD*, char*);
 BOARDLIST* generateWhiteBoardlist(BOARD*, int);
 BOARDLIST* generateBlackBoardlist(BOARD*, int, unsigned int*);
 void weedOutShortVars(BOARDLIST*, unsigned char);
 void weedOutLongVars(BOARDLIST*);
 bool isKey(BOARD*);
+bool hasLegalMove(POSITION*, unsigned char, bool, enum COLOUR);
+bool forcedGoal(BOARD*, enum COLOUR, enum AIM);
+bool goalInOne(BOARD*, enum COLOUR, enum AIM);
 void generateKingMoves(BOARD*, enum COLOUR, BOARDLIST*);
 bool deepEquals(BOARD*, BOARD*);
 bool bListEquals(BOARDLIST*, BOARDLIST*);
+uint64_t boardFingerprint(BOARD*);
+uint64_t listFingerprint(BOARDLIST*);
 void putRefutsToEnd(BOARDLIST*);
-void getHashKey(BOARD*, HASHKEY*);
+void getHashKey(BOARD*, unsigned char, HASHKEY*);
+unsigned char mapSquare(unsigned char, unsigned char);
+unsigned char symInverse(unsigned char);
 HASHVALUE* getHashValue(void);
 KILLERHASHVALUE* getKillerHashValue(void);
 void getKillerHashKey(BOARD*, KILLERKEY*);
@@ -0,0 +1,131 @@
+/*
+ *	stats.c
+ *	(c) 2020, Brian Stephenson
+ *	brian@bstephen.me.uk
+ *
+ *	A program to test orthodox chess problems of the types:
+ *
+ *		directmates
+ *		selfmates
+ *		relfexmates
+ *		helpmates
+ *
+ *	Input is taken from the program options and output is xml on stdout.
+ *
+ *	This is the module that times the solving phases and writes the
+ *	runtime statistics as a single line of JSON, for --stats=json and the
+ *	stats of an --output=jsonl record.
+ */
+
+#include "sengine.h"
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+extern unsigned int opt_moves;
+
+const char* const phase_names[PHASES] = {
+    "gloss", "trieskeys", "threats", "setplay", "setthreats", "classify",
+    "xml"
+};
+
+static struct timespec wall_start[PHASES];
+static clock_t cpu_start[PHASES];
+
+void start_phase(enum PHASE ph)
+{
+    (void) clock_gettime(CLOCK_MONOTONIC, &wall_start[ph]);
+    cpu_start[ph] = clock();
+    return;
+}
+
+void end_phase(enum PHASE ph)
+{
+    struct timespec now;
+    (void) clock_gettime(CLOCK_MONOTONIC, &now);
+    stats.cpu[ph] += (double)(clock() - cpu_start[ph]) / CLOCKS_PER_SEC;
+    stats.wall[ph] += (double)(now.tv_sec - wall_start[ph].tv_sec)
+                      + (double)(now.tv_nsec - wall_start[ph].tv_nsec) / 1e9;
+    return;
+}
+
+static long peak_rss_kb(void)
+{
+#ifdef __linux__
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        return ru.ru_maxrss;
+    }
+
+#endif
+    return 0;
+}
+
+static void print_nodes(UT_string* s, enum COLOUR side)
+{
+    unsigned int ply;
+    unsigned int last = (opt_moves < STATS_PLIES) ? opt_moves : STATS_PLIES - 1;
+
+    utstring_printf(s, "[");
+
+    for (ply = 1; ply <= last; ply++) {
+        utstring_printf(s, "%s%" PRIu64, (ply == 1) ? "" : ",",
+                        stats.nodes[side][ply]);
+    }
+
+    utstring_printf(s, "]");
+    return;
+}
+
+/*
+ * The table hits that answered with no continuation and with a list are
+ * counted by the solver.
+ */
+void stats_json(UT_string* s, unsigned int hit_null, unsigned int hit_list)
+{
+    int ph;
+    utstring_printf(s, "{\"nodes\":{\"white\":");
+    print_nodes(s, WHITE);
+    utstring_printf(s, ",\"black\":");
+    print_nodes(s, BLACK);
+    utstring_printf(s, "},\"moves_generated\":%" PRIu64, stats.moves_generated);
+    utstring_printf(s, ",\"attacks_calls\":%" PRIu64, stats.attacks_calls);
+    utstring_printf(s, ",\"mate_tests\":%" PRIu64, stats.mate_tests);
+    utstring_printf(s, ",\"tt\":{\"probes\":%" PRIu64 ",\"hits\":%" PRIu64
+                    ",\"sym_hits\":%" PRIu64 ",\"hits_null\":%u,\"hits_list\":%u"
+                    ",\"stores\":%" PRIu64 ",\"replacements\":%" PRIu64 "}",
+                    stats.tt_probes, stats.tt_hits, stats.tt_sym_hits,
+                    hit_null, hit_list,
+                    stats.tt_stores, stats.tt_replacements);
+    utstring_printf(s, ",\"killer_hits\":%" PRIu64, stats.killer_hits);
+    utstring_printf(s, ",\"threat_hits\":%" PRIu64, stats.threat_hits);
+    utstring_printf(s, ",\"tb_cutoffs\":%" PRIu64, stats.tb_cutoffs);
+    utstring_printf(s, ",\"intel_cutoffs\":%" PRIu64, stats.intel_cutoffs);
+    utstring_printf(s, ",\"peaks\":{\"boards\":%" PRIu64 ",\"positions\":%"
+                    PRIu64 ",\"boardlists\":%" PRIu64 ",\"hashvalues\":%" PRIu64
+                    ",\"bytes\":%" PRIu64 "}", stats.board_peak,
+                    stats.position_peak, stats.boardlist_peak,
+                    stats.hashvalue_peak, stats.mem_peak);
+    utstring_printf(s, ",\"phases\":{");
+
+    for (ph = 0; ph < PHASES; ph++) {
+        utstring_printf(s, "%s\"%s\":{\"wall\":%f,\"cpu\":%f}",
+                        (ph == 0) ? "" : ",", phase_names[ph], stats.wall[ph],
+                        stats.cpu[ph]);
+    }
+
+    utstring_printf(s, "},\"rss_kb\":%ld}", peak_rss_kb());
+    return;
+}
+
+void print_stats_json(FILE* fp, unsigned int hit_null, unsigned int hit_list)
+{
+    UT_string* s;
+    utstring_new(s);
+    stats_json(s, hit_null, hit_list);
+    (void) fprintf(fp, "%s\n", utstring_body(s));
+    utstring_free(s);
+    return;
+}
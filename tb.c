@@ -0,0 +1,731 @@
+/*
+ *	tb.c
+ *	(c) 2020, Brian Stephenson
+ *	brian@bstephen.me.uk
+ *
+ *	A program to test orthodox chess problems of the types:
+ *
+ *		directmates
+ *		selfmates
+ *		relfexmates
+ *		helpmates
+ *
+ *	Input is taken from the program options and output is xml on stdout.
+ *
+ *	This is the module for the mini-tablebases. For pawnless material of
+ *	at most four men it holds, for every position, how many White moves
+ *	mate takes with best play, so the search can drop a subtree that cannot
+ *	mate in the moves left without searching it.
+ *
+ *	A table is built by retrograde analysis, working back from the mates
+ *	with un-moves made from the same attack tables as the move generator,
+ *	and answering captures from the table for the material left. Three man
+ *	tables are built in memory once the search has asked for the material
+ *	often enough to repay the build, a fraction of a second. Four man
+ *	tables take longer and are only used with --tb=DIR: each is built the
+ *	first time it is needed into DIR/<material>.tb and memory-mapped.
+ */
+
+#include "sengine.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TB_VERSION 1
+#define TB_MAXMEN 4
+#define TB_SIGS 512
+#define TB_NOMATE 255
+#define TB_PENDING_DONE 255
+#define TB_BUILD_PROBES 100000
+
+extern char* opt_tb;
+extern BITBOARD setMask[64];
+extern BITBOARD king_attacks[64];
+extern BITBOARD knight_attacks[64];
+extern BITBOARD bishop_attacks[64];
+extern BITBOARD rook_attacks[64];
+extern BBOARD rook_commonAttacks[64][64];
+extern BBOARD bishop_commonAttacks[64][64];
+
+int tzcount(BITBOARD inBrd);
+
+/*
+ * The men are the white king, the black king, the other white men from
+ * the strongest down and then the black man, if any. A position is the
+ * index sum of square[i] << (6 * i).
+ */
+typedef struct TBASE {
+    int men;
+    enum PIECE piece[TB_MAXMEN];
+    enum COLOUR colour[TB_MAXMEN];
+    size_t size;
+    unsigned char* wtm;          /* Mate in n with White to move. */
+    unsigned char* btm;          /* n White moves to mate with Black to move, 0 if mated. */
+    void* map;                   /* The mapped file, if read from one. */
+} TBASE;
+
+typedef struct TB_HEADER {
+    char magic[8];
+    uint32_t version;
+    uint32_t men;
+} TB_HEADER;
+
+static const char tb_magic[8] = "SENTBASE";
+static const char pcLetters[] = "**SBRQK";
+static TBASE* tables[TB_SIGS];
+static bool tried[TB_SIGS];
+static unsigned int asked[TB_SIGS];
+
+static TBASE* getTable(unsigned int);
+
+static unsigned int signature(enum PIECE w1, enum PIECE w2, enum PIECE b1)
+{
+    return (unsigned int) w1 + ((unsigned int) w2 << 3) + ((unsigned int) b1 << 6);
+}
+
+static size_t tbIndex(const unsigned char* sq, int men)
+{
+    size_t idx = 0;
+    int i;
+
+    for (i = men - 1; i >= 0; i--) {
+        idx = (idx << 6) | sq[i];
+    }
+
+    return idx;
+}
+
+static BITBOARD slide(BITBOARD ray, BBOARD between[64][64], int from, BITBOARD occ)
+{
+    BITBOARD att = 0;
+    int to = tzcount(ray);
+
+    while (to < 64) {
+        if ((between[from][to].bb & occ) == 0) {
+            att |= setMask[to];
+        }
+
+        ray &= ray - 1;
+        to = tzcount(ray);
+    }
+
+    return att;
+}
+
+static BITBOARD attacksFrom(enum PIECE piece, int from, BITBOARD occ)
+{
+    switch (piece) {
+    case KING:
+        return king_attacks[from];
+
+    case KNIGHT:
+        return knight_attacks[from];
+
+    case BISHOP:
+        return slide(bishop_attacks[from], bishop_commonAttacks, from, occ);
+
+    case ROOK:
+        return slide(rook_attacks[from], rook_commonAttacks, from, occ);
+
+    case QUEEN:
+        return slide(bishop_attacks[from], bishop_commonAttacks, from, occ)
+               | slide(rook_attacks[from], rook_commonAttacks, from, occ);
+
+    default:
+        assert(0);
+        return 0;
+    }
+}
+
+static bool reaches(enum PIECE piece, int from, int to, BITBOARD occ)
+{
+    switch (piece) {
+    case KING:
+        return (king_attacks[from] & setMask[to]) != 0;
+
+    case KNIGHT:
+        return (knight_attacks[from] & setMask[to]) != 0;
+
+    case BISHOP:
+        return (bishop_commonAttacks[from][to].used == true)
+               && ((bishop_commonAttacks[from][to].bb & occ) == 0);
+
+    case ROOK:
+        return (rook_commonAttacks[from][to].used == true)
+               && ((rook_commonAttacks[from][to].bb & occ) == 0);
+
+    case QUEEN:
+        return reaches(BISHOP, from, to, occ) || reaches(ROOK, from, to, occ);
+
+    default:
+        assert(0);
+        return false;
+    }
+}
+
+static BITBOARD occupancy(TBASE* tb, const unsigned char* sq, int skip)
+{
+    BITBOARD occ = 0;
+    int i;
+
+    for (i = 0; i < tb->men; i++) {
+        if (i != skip) {
+            occ |= setMask[sq[i]];
+        }
+    }
+
+    return occ;
+}
+
+/*
+ * Whether the king of colour c is attacked, with man skip (if any) off
+ * the board.
+ */
+static bool kingAttacked(TBASE* tb, const unsigned char* sq, enum COLOUR c, int skip)
+{
+    BITBOARD occ = occupancy(tb, sq, skip);
+    int i;
+
+    for (i = 0; i < tb->men; i++) {
+        if ((i != skip) && (tb->colour[i] != c)
+                && (reaches(tb->piece[i], sq[i], sq[c], occ) == true)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool distinct(const unsigned char* sq, int men)
+{
+    BITBOARD seen = 0;
+    int i;
+
+    for (i = 0; i < men; i++) {
+        if ((seen & setMask[sq[i]]) != 0) {
+            return false;
+        }
+
+        seen |= setMask[sq[i]];
+    }
+
+    return true;
+}
+
+/*
+ * The value, from the table for the material left, of the position after
+ * man i takes man j on sq[j]: White to move there if Black took.
+ */
+static unsigned char captureValue(TBASE* tb, const unsigned char* sq, int i, int j)
+{
+    unsigned char nsq[TB_MAXMEN];
+    enum PIECE w[2] = { NOPIECE, NOPIECE };
+    enum PIECE b = NOPIECE;
+    TBASE* sub;
+    int k;
+    int n = 0;
+    int nw = 0;
+
+    for (k = 0; k < tb->men; k++) {
+        if (k != j) {
+            nsq[n] = (k == i) ? sq[j] : sq[k];
+
+            if ((k > 1) && (tb->colour[k] == WHITE)) {
+                w[nw++] = tb->piece[k];
+            } else if (k > 1) {
+                b = tb->piece[k];
+            }
+
+            n++;
+        }
+    }
+
+    // Without a white man besides the king, White cannot mate.
+    if (w[0] == NOPIECE) {
+        return TB_NOMATE;
+    }
+
+    // Captures only lead to three man tables, which are always built.
+    sub = getTable(signature(w[0], w[1], b));
+    assert(sub != NULL);
+    return (tb->colour[i] == WHITE) ? sub->btm[tbIndex(nsq, n)] : sub->wtm[tbIndex(nsq, n)];
+}
+
+/*
+ * Seeds the table: mates, stalemates and positions Black must leave by
+ * a capture, and the mates White can reach by capturing.
+ */
+static void seed(TBASE* tb, unsigned char* pending, unsigned char* capped)
+{
+    unsigned char sq[TB_MAXMEN];
+    size_t idx;
+    int i;
+    int j;
+
+    for (idx = 0; idx < tb->size; idx++) {
+        BITBOARD occ;
+        BITBOARD own;
+
+        for (i = 0; i < tb->men; i++) {
+            sq[i] = (unsigned char)((idx >> (6 * i)) & 63);
+        }
+
+        pending[idx] = TB_PENDING_DONE;
+
+        if (distinct(sq, tb->men) == false) {
+            continue;
+        }
+
+        occ = occupancy(tb, sq, -1);
+
+        if (kingAttacked(tb, sq, WHITE, -1) == false) {
+            // Black to move.
+            unsigned int quiet = 0;
+            unsigned int moves = 0;
+            unsigned char worst = 0;
+            bool drawn = false;
+            own = 0;
+
+            for (i = 0; i < tb->men; i++) {
+                if (tb->colour[i] == BLACK) {
+                    own |= setMask[sq[i]];
+                }
+            }
+
+            for (i = 0; (i < tb->men) && (drawn == false); i++) {
+                BITBOARD to;
+                unsigned char from = sq[i];
+
+                if (tb->colour[i] != BLACK) {
+                    continue;
+                }
+
+                to = attacksFrom(tb->piece[i], from, occ) & ~own;
+
+                while ((to != 0) && (drawn == false)) {
+                    int t = tzcount(to);
+                    int victim = -1;
+                    to &= to - 1;
+
+                    for (j = 0; j < tb->men; j++) {
+                        if ((tb->colour[j] == WHITE) && (sq[j] == t)) {
+                            victim = j;
+                        }
+                    }
+
+                    sq[i] = (unsigned char) t;
+
+                    if (kingAttacked(tb, sq, BLACK, victim) == false) {
+                        moves++;
+
+                        if (victim < 0) {
+                            quiet++;
+                        } else {
+                            unsigned char v = captureValue(tb, sq, i, victim);
+
+                            if (v == TB_NOMATE) {
+                                drawn = true;
+                            } else if (v > worst) {
+                                worst = v;
+                            }
+                        }
+                    }
+
+                    sq[i] = from;
+                }
+            }
+
+            if (drawn == true) {
+                // Not won.
+            } else if (moves == 0) {
+                if (kingAttacked(tb, sq, BLACK, -1) == true) {
+                    tb->btm[idx] = 0;
+                }
+            } else if (quiet == 0) {
+                tb->btm[idx] = worst;
+            } else {
+                pending[idx] = (unsigned char) quiet;
+                capped[idx] = worst;
+            }
+        }
+
+        if (kingAttacked(tb, sq, BLACK, -1) == false) {
+            // White to move: only captures are seeded, the rest come back.
+            own = 0;
+
+            for (i = 0; i < tb->men; i++) {
+                if (tb->colour[i] == WHITE) {
+                    own |= setMask[sq[i]];
+                }
+            }
+
+            for (i = 0; i < tb->men; i++) {
+                BITBOARD to;
+                unsigned char from = sq[i];
+
+                if (tb->colour[i] != WHITE) {
+                    continue;
+                }
+
+                to = attacksFrom(tb->piece[i], from, occ) & ~own;
+
+                while (to != 0) {
+                    int t = tzcount(to);
+                    to &= to - 1;
+
+                    for (j = 2; j < tb->men; j++) {
+                        if ((tb->colour[j] == BLACK) && (sq[j] == t)) {
+                            sq[i] = (unsigned char) t;
+
+                            if (kingAttacked(tb, sq, WHITE, j) == false) {
+                                unsigned char v = captureValue(tb, sq, i, j);
+
+                                if ((v != TB_NOMATE) && ((v + 1) < tb->wtm[idx])) {
+                                    tb->wtm[idx] = (unsigned char)(v + 1);
+                                }
+                            }
+
+                            sq[i] = from;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return;
+}
+
+/*
+ * Takes back each quiet move of colour c that leads to position idx and
+ * calls back with the position before it, if that was a legal one.
+ */
+static void unmoves(TBASE* tb, size_t idx, enum COLOUR c, unsigned int d,
+                    unsigned char* pending, unsigned char* capped)
+{
+    unsigned char sq[TB_MAXMEN];
+    BITBOARD occ;
+    int i;
+
+    for (i = 0; i < tb->men; i++) {
+        sq[i] = (unsigned char)((idx >> (6 * i)) & 63);
+    }
+
+    occ = occupancy(tb, sq, -1);
+
+    for (i = 0; i < tb->men; i++) {
+        BITBOARD from;
+        unsigned char to = sq[i];
+
+        if (tb->colour[i] != c) {
+            continue;
+        }
+
+        from = attacksFrom(tb->piece[i], to, occ) & ~occ;
+
+        while (from != 0) {
+            size_t prev;
+            sq[i] = (unsigned char) tzcount(from);
+            from &= from - 1;
+            prev = tbIndex(sq, tb->men);
+
+            // Settled positions are skipped before the legality test, which
+            // is that the side not to move before the un-move is not in check.
+            if (c == WHITE) {
+                if ((d < tb->wtm[prev]) && (kingAttacked(tb, sq, BLACK, -1) == false)) {
+                    tb->wtm[prev] = (unsigned char) d;
+                }
+            } else if ((pending[prev] != TB_PENDING_DONE)
+                       && (kingAttacked(tb, sq, WHITE, -1) == false)
+                       && (--pending[prev] == 0)) {
+                pending[prev] = TB_PENDING_DONE;
+                tb->btm[prev] = (unsigned char)((capped[prev] > d) ? capped[prev] : d);
+            }
+        }
+
+        sq[i] = to;
+    }
+
+    return;
+}
+
+static void build(TBASE* tb)
+{
+    unsigned char* pending = (unsigned char*) malloc(tb->size);
+    unsigned char* capped = (unsigned char*) calloc(tb->size, 1);
+    unsigned int d;
+    size_t idx;
+    SENGINE_MEM_ASSERT(pending);
+    SENGINE_MEM_ASSERT(capped);
+    (void) memset(tb->wtm, TB_NOMATE, tb->size);
+    (void) memset(tb->btm, TB_NOMATE, tb->size);
+    seed(tb, pending, capped);
+
+    // Values of d and more may still be set when a pass finds nothing new.
+    for (d = 1; d < TB_NOMATE; d++) {
+        bool found = false;
+
+        for (idx = 0; idx < tb->size; idx++) {
+            if (tb->btm[idx] == (d - 1)) {
+                unmoves(tb, idx, WHITE, d, pending, capped);
+            }
+        }
+
+        for (idx = 0; idx < tb->size; idx++) {
+            if (tb->wtm[idx] == d) {
+                found = true;
+                unmoves(tb, idx, BLACK, d, pending, capped);
+            } else if ((tb->wtm[idx] > d) && (tb->wtm[idx] != TB_NOMATE)) {
+                found = true;
+            }
+
+            if ((tb->btm[idx] >= d) && (tb->btm[idx] != TB_NOMATE)) {
+                found = true;
+            }
+        }
+
+        if (found == false) {
+            break;
+        }
+    }
+
+    free(pending);
+    free(capped);
+    return;
+}
+
+static char* tablePath(TBASE* tb)
+{
+    char* path = (char*) malloc(strlen(opt_tb) + TB_MAXMEN + 8);
+    char* p;
+    int i;
+    SENGINE_MEM_ASSERT(path);
+    p = path + sprintf(path, "%s/K", opt_tb);
+
+    for (i = 2; (i < tb->men) && (tb->colour[i] == WHITE); i++) {
+        *p++ = pcLetters[tb->piece[i]];
+    }
+
+    *p++ = 'K';
+
+    for (; i < tb->men; i++) {
+        *p++ = pcLetters[tb->piece[i]];
+    }
+
+    (void) strcpy(p, ".tb");
+    return path;
+}
+
+static void tbError(const char* msg, const char* file)
+{
+    (void) fprintf(stderr, "sengine ERROR: %s => %s\n", msg, file);
+    exit(1);
+}
+
+static bool mapTable(TBASE* tb, const char* path)
+{
+    TB_HEADER* hdr;
+    size_t len = sizeof(TB_HEADER) + 2 * tb->size;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    tb->map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    (void) close(fd);
+
+    if (tb->map == MAP_FAILED) {
+        tbError("cannot map tablebase", path);
+    }
+
+    hdr = (TB_HEADER*) tb->map;
+
+    if ((memcmp(hdr->magic, tb_magic, sizeof(hdr->magic)) != 0)
+            || (hdr->version != TB_VERSION) || (hdr->men != (uint32_t) tb->men)) {
+        tbError("not a tablebase for this version", path);
+    }
+
+    tb->wtm = (unsigned char*)(hdr + 1);
+    tb->btm = tb->wtm + tb->size;
+    return true;
+}
+
+/*
+ * Builds the table into a temporary file renamed into place, so another
+ * run never maps a half-written one.
+ */
+static void writeTable(TBASE* tb, const char* path)
+{
+    TB_HEADER hdr;
+    char* tmp = (char*) malloc(strlen(path) + 8);
+    int fd;
+    SENGINE_MEM_ASSERT(tmp);
+    (void) sprintf(tmp, "%s.XXXXXX", path);
+    fd = mkstemp(tmp);
+
+    if (fd < 0) {
+        tbError("cannot create tablebase", tmp);
+    }
+
+    (void) memset(&hdr, 0, sizeof(hdr));
+    (void) memcpy(hdr.magic, tb_magic, sizeof(hdr.magic));
+    hdr.version = TB_VERSION;
+    hdr.men = (uint32_t) tb->men;
+
+    if ((fchmod(fd, 0644) != 0) || (write(fd, &hdr, sizeof(hdr)) != (ssize_t) sizeof(hdr))
+            || (write(fd, tb->wtm, tb->size) != (ssize_t) tb->size)
+            || (write(fd, tb->btm, tb->size) != (ssize_t) tb->size)
+            || (close(fd) != 0) || (rename(tmp, path) != 0)) {
+        tbError("cannot write tablebase", tmp);
+    }
+
+    free(tmp);
+    return;
+}
+
+static TBASE* getTable(unsigned int sig)
+{
+    TBASE* tb;
+    enum PIECE w1 = (enum PIECE)(sig & 7);
+    enum PIECE w2 = (enum PIECE)((sig >> 3) & 7);
+    enum PIECE b1 = (enum PIECE)(sig >> 6);
+
+    if (tried[sig] == true) {
+        return tables[sig];
+    }
+
+    tried[sig] = true;
+    tb = (TBASE*) calloc(1, sizeof(TBASE));
+    SENGINE_MEM_ASSERT(tb);
+    tb->piece[0] = KING;
+    tb->colour[0] = WHITE;
+    tb->piece[1] = KING;
+    tb->colour[1] = BLACK;
+    tb->men = 2;
+    tb->piece[tb->men] = w1;
+    tb->colour[tb->men++] = WHITE;
+
+    if (w2 != NOPIECE) {
+        tb->piece[tb->men] = w2;
+        tb->colour[tb->men++] = WHITE;
+    }
+
+    if (b1 != NOPIECE) {
+        tb->piece[tb->men] = b1;
+        tb->colour[tb->men++] = BLACK;
+    }
+
+    tb->size = (size_t) 1 << (6 * tb->men);
+
+    if (tb->men < TB_MAXMEN) {
+        tb->wtm = (unsigned char*) malloc(tb->size);
+        tb->btm = (unsigned char*) malloc(tb->size);
+        SENGINE_MEM_ASSERT(tb->wtm);
+        SENGINE_MEM_ASSERT(tb->btm);
+        build(tb);
+    } else if (opt_tb != NULL) {
+        char* path = tablePath(tb);
+
+        if (mapTable(tb, path) == false) {
+            if ((mkdir(opt_tb, 0777) != 0) && (errno != EEXIST)) {
+                tbError("cannot create tablebase directory", opt_tb);
+            }
+
+            tb->wtm = (unsigned char*) malloc(tb->size);
+            tb->btm = (unsigned char*) malloc(tb->size);
+            SENGINE_MEM_ASSERT(tb->wtm);
+            SENGINE_MEM_ASSERT(tb->btm);
+            build(tb);
+            writeTable(tb, path);
+            free(tb->wtm);
+            free(tb->btm);
+
+            if (mapTable(tb, path) == false) {
+                tbError("cannot open tablebase", path);
+            }
+        }
+
+        free(path);
+    } else {
+        free(tb);
+        tb = NULL;
+    }
+
+    tables[sig] = tb;
+    return tb;
+}
+
+/*
+ * The White moves mate takes from pos with toPlay to move, TB_NOMATE if
+ * White cannot force it, or -1 if there is no table for the position.
+ */
+int tb_probe(POSITION* pos, enum COLOUR toPlay)
+{
+    static const enum PIECE order[] = { QUEEN, ROOK, BISHOP, KNIGHT };
+    enum PIECE w[2] = { NOPIECE, NOPIECE };
+    enum PIECE b = NOPIECE;
+    unsigned char sq[TB_MAXMEN];
+    BITBOARD occ;
+    TBASE* tb;
+    unsigned int sig;
+    int men = 2;
+    int nw = 0;
+    int i;
+
+    if (((pos->flags & (B_KING_CASTLING | B_QUEEN_CASTLING | W_KING_CASTLING
+                        | W_QUEEN_CASTLING)) != 0)
+            || ((pos->bitBoard[WHITE][PAWN] | pos->bitBoard[BLACK][PAWN]) != 0)) {
+        return -1;
+    }
+
+    occ = pos->bitBoard[WHITE][OCCUPIED] | pos->bitBoard[BLACK][OCCUPIED];
+
+    if (__builtin_popcountll(occ) > TB_MAXMEN) {
+        return -1;
+    }
+
+    sq[0] = pos->kingsq[WHITE];
+    sq[1] = pos->kingsq[BLACK];
+
+    for (i = 0; i < 4; i++) {
+        BITBOARD pcs = pos->bitBoard[WHITE][order[i]];
+
+        while (pcs != 0) {
+            w[nw++] = order[i];
+            sq[men++] = (unsigned char) tzcount(pcs);
+            pcs &= pcs - 1;
+        }
+    }
+
+    // A lone white king never mates.
+    if (nw == 0) {
+        return TB_NOMATE;
+    }
+
+    for (i = 0; i < 4; i++) {
+        BITBOARD pcs = pos->bitBoard[BLACK][order[i]];
+
+        if (pcs != 0) {
+            b = order[i];
+            sq[men++] = (unsigned char) tzcount(pcs);
+        }
+    }
+
+    sig = signature(w[0], w[1], b);
+
+    if ((tried[sig] == false) && (men < TB_MAXMEN) && (++asked[sig] < TB_BUILD_PROBES)) {
+        return -1;
+    }
+
+    tb = getTable(sig);
+
+    if (tb == NULL) {
+        return -1;
+    }
+
+    assert(tb->men == men);
+    return (toPlay == WHITE) ? tb->wtm[tbIndex(sq, men)] : tb->btm[tbIndex(sq, men)];
+}
@@ -0,0 +1,411 @@
+/*
+ *	twin.c
+ *	(c) 2020, Brian Stephenson
+ *	brian@bstephen.me.uk
+ *
+ *	A program to test orthodox chess problems of the types:
+ *
+ *		directmates
+ *		selfmates
+ *		relfexmates
+ *		helpmates
+ *
+ *	Input is taken from the program options and output is xml on stdout.
+ *
+ *	This is the module for --twins, which solves twins of the diagram in
+ *	the same run. Twins are separated by '/', and each is a list of
+ *	changes to the diagram separated by ',':
+ *
+ *		d2d4	the man on d2 moves to d4
+ *		-h7	the man on h7 is removed
+ *		+wSe5	a white knight (Q, R, B, S or P) is added on e5
+ *		c:Kq	the castling rights become Kq, or none for c:-
+ *		ep:e4	the pawn on e4 can be taken ep, or none for ep:-
+ *
+ *	A twin is selected by writing its diagram into the --kings, --gbr,
+ *	--pos, --castling and --ep options, so it is set up, reported and
+ *	cached exactly as if it had been given on its own. The searches keep
+ *	their transposition tables from one twin to the next, as the entries
+ *	are keyed by the whole position.
+ */
+
+#include "sengine.h"
+#include <ctype.h>
+
+extern char* opt_kings;
+extern char* opt_gbr;
+extern char* opt_pos;
+extern char* opt_castling;
+extern char* opt_ep;
+extern char* opt_twins;
+
+extern BITBOARD setMask[64];
+
+static const enum PIECE gbr_order[4] = { QUEEN, ROOK, BISHOP, KNIGHT };
+static const char piece_letters[] = " PSBRQK";
+
+/*
+ * The diagram as given, which every twin changes, and the options it was
+ * given in.
+ */
+static char base_men[64];
+static char* base_kings = NULL;
+static char* base_gbr = NULL;
+static char* base_pos = NULL;
+static char* base_castling = NULL;
+static char* base_ep = NULL;
+static bool base_taken = false;
+
+static char twin_kings[5];
+static char twin_gbr[8];
+static char twin_pos[129];
+static char twin_castling[5];
+static char twin_ep[3];
+
+static bool isSquare(const char* s)
+{
+    return (s[0] >= 'a') && (s[0] <= 'h') && (s[1] >= '1') && (s[1] <= '8');
+}
+
+static int squareOf(const char* s)
+{
+    return SQUARE_TO_INT(s);
+}
+
+static void squareName(int sq, char* s)
+{
+    s[0] = (char)('a' + FILE(sq));
+    s[1] = (char)('1' + RANK(sq));
+    return;
+}
+
+/*
+ * The length of the change at s, or 0 if it is not one.
+ */
+static size_t changeLength(const char* s)
+{
+    size_t len = strcspn(s, ",/");
+
+    if ((len == 3) && (s[0] == '-') && (isSquare(s + 1) == true)) {
+        return len;
+    }
+
+    if ((len == 5) && (s[0] == '+') && ((s[1] == 'w') || (s[1] == 'b'))
+            && (strchr("QRBSP", s[2]) != NULL) && (isSquare(s + 3) == true)) {
+        return len;
+    }
+
+    if ((len == 4) && (isSquare(s) == true) && (isSquare(s + 2) == true)) {
+        return len;
+    }
+
+    if ((len >= 3) && (strncmp(s, "c:", 2) == 0)) {
+        if ((len == 3) && (s[2] == '-')) {
+            return len;
+        }
+
+        if ((len <= 6) && (strspn(s + 2, "KQkq") == (len - 2))) {
+            return len;
+        }
+    }
+
+    if ((len == 4) && (strncmp(s, "ep:", 3) == 0) && (s[3] == '-')) {
+        return len;
+    }
+
+    if ((len == 5) && (strncmp(s, "ep:", 3) == 0) && (isSquare(s + 3) == true)) {
+        return len;
+    }
+
+    return 0;
+}
+
+/*
+ * Whether spec is a valid --twins value; what the changes do to the
+ * diagram is only checked when a twin is selected.
+ */
+bool twin_valid(const char* spec)
+{
+    const char* s = spec;
+
+    for (;;) {
+        size_t len = changeLength(s);
+
+        if (len == 0) {
+            return false;
+        }
+
+        s += len;
+
+        if (*s == '\0') {
+            return true;
+        }
+
+        s++;
+    }
+}
+
+/*
+ * The number of twins besides the diagram itself.
+ */
+unsigned int twin_count(void)
+{
+    const char* s = opt_twins;
+    unsigned int n = 1;
+
+    if (opt_twins == NULL) {
+        return 0;
+    }
+
+    while ((s = strchr(s, '/')) != NULL) {
+        n++;
+        s++;
+    }
+
+    return n;
+}
+
+static void takeBase(void)
+{
+    BOARD* b = setup_diagram(BLACK);
+    enum COLOUR c;
+    enum PIECE p;
+    int sq;
+    (void) memset(base_men, ' ', sizeof(base_men));
+
+    for (c = WHITE; c <= BLACK; c++) {
+        for (p = PAWN; p <= KING; p++) {
+            for (sq = 0; sq < 64; sq++) {
+                if ((b->pos->bitBoard[c][p] & setMask[sq]) != 0) {
+                    base_men[sq] = (c == WHITE) ? piece_letters[p]
+                                   : (char) tolower(piece_letters[p]);
+                }
+            }
+        }
+    }
+
+    freeBoard(b);
+    base_kings = opt_kings;
+    base_gbr = opt_gbr;
+    base_pos = opt_pos;
+    base_castling = opt_castling;
+    base_ep = opt_ep;
+    base_taken = true;
+    return;
+}
+
+static int twinError(unsigned int t, const char* why, const char* change,
+                     size_t len)
+{
+    if (len == 0) {
+        (void) fprintf(stderr, "sengine ERROR: twin (%c): %s\n",
+                       (char)('a' + t), why);
+    } else {
+        (void) fprintf(stderr, "sengine ERROR: twin (%c): %s => %.*s\n",
+                       (char)('a' + t), why, (int) len, change);
+    }
+
+    return 1;
+}
+
+/*
+ * Applies one change to men, or returns non-zero.
+ */
+static int applyChange(unsigned int t, const char* s, size_t len, char* men)
+{
+    int from;
+    int to;
+
+    if (s[0] == '-') {
+        from = squareOf(s + 1);
+
+        if ((men[from] == ' ') || (toupper(men[from]) == 'K')) {
+            return twinError(t, "no man that can be removed", s, len);
+        }
+
+        men[from] = ' ';
+    } else if (s[0] == '+') {
+        to = squareOf(s + 3);
+
+        if (men[to] != ' ') {
+            return twinError(t, "square taken", s, len);
+        }
+
+        men[to] = (s[1] == 'w') ? s[2] : (char) tolower(s[2]);
+    } else if (strncmp(s, "c:", 2) == 0) {
+        if (s[2] == '-') {
+            twin_castling[0] = '\0';
+        } else {
+            (void) sprintf(twin_castling, "%.*s", (int)(len - 2), s + 2);
+        }
+    } else if (strncmp(s, "ep:", 3) == 0) {
+        if (s[3] == '-') {
+            twin_ep[0] = '\0';
+        } else {
+            squareName(squareOf(s + 3), twin_ep);
+            twin_ep[2] = '\0';
+        }
+    } else {
+        from = squareOf(s);
+        to = squareOf(s + 2);
+
+        if ((men[from] == ' ') || (men[to] != ' ')) {
+            return twinError(t, "no man to move, or square taken", s, len);
+        }
+
+        men[to] = men[from];
+        men[from] = ' ';
+    }
+
+    return 0;
+}
+
+/*
+ * Writes men out as the --kings, --gbr and --pos options, or returns
+ * non-zero for what those cannot hold.
+ */
+static int encode(unsigned int t, const char* men)
+{
+    char* po = twin_pos;
+    int counts[2];
+    int i;
+    int sq;
+    int k[2] = { -1, -1 };
+
+    for (sq = 0; sq < 64; sq++) {
+        if (men[sq] == 'K') {
+            k[WHITE] = sq;
+        } else if (men[sq] == 'k') {
+            k[BLACK] = sq;
+        } else if ((toupper(men[sq]) == 'P') && ((RANK(sq) == 0) || (RANK(sq) == 7))) {
+            return twinError(t, "pawn on the first or last rank", "", 0);
+        }
+    }
+
+    if ((abs(FILE(k[WHITE]) - FILE(k[BLACK])) <= 1)
+            && (abs(RANK(k[WHITE]) - RANK(k[BLACK])) <= 1)) {
+        return twinError(t, "kings next to each other", "", 0);
+    }
+
+    squareName(k[WHITE], twin_kings);
+    squareName(k[BLACK], twin_kings + 2);
+    twin_kings[4] = '\0';
+
+    for (i = 0; i < 4; i++) {
+        char w = piece_letters[gbr_order[i]];
+        counts[WHITE] = 0;
+        counts[BLACK] = 0;
+
+        for (sq = 0; sq < 64; sq++) {
+            if (men[sq] == w) {
+                counts[WHITE]++;
+                squareName(sq, po);
+                po += 2;
+            }
+        }
+
+        for (sq = 0; sq < 64; sq++) {
+            if (men[sq] == (char) tolower(w)) {
+                counts[BLACK]++;
+                squareName(sq, po);
+                po += 2;
+            }
+        }
+
+        // A GBR digit holds up to two men of a colour.
+        if ((counts[WHITE] > 2) || (counts[BLACK] > 2)) {
+            return twinError(t, "more men of a kind than --gbr can hold", "", 0);
+        }
+
+        twin_gbr[i] = (char)('0' + counts[WHITE] + (3 * counts[BLACK]));
+    }
+
+    twin_gbr[4] = '.';
+
+    for (i = 0; i < 2; i++) {
+        char p = (i == 0) ? 'P' : 'p';
+        int n = 0;
+
+        for (sq = 0; sq < 64; sq++) {
+            if (men[sq] == p) {
+                n++;
+                squareName(sq, po);
+                po += 2;
+            }
+        }
+
+        twin_gbr[5 + i] = (char)('0' + n);
+    }
+
+    twin_gbr[7] = '\0';
+    *po = '\0';
+    return 0;
+}
+
+/*
+ * Selects twin t, 0 being the diagram itself, for the next setup_diagram().
+ * Returns non-zero, having said why, if its changes do not make a diagram.
+ */
+int twin_select(unsigned int t)
+{
+    char men[64];
+    const char* s = opt_twins;
+    unsigned int i;
+    int rc = 0;
+
+    if (base_taken == false) {
+        takeBase();
+    }
+
+    opt_kings = base_kings;
+    opt_gbr = base_gbr;
+    opt_pos = base_pos;
+    opt_castling = base_castling;
+    opt_ep = base_ep;
+
+    if (t == 0) {
+        return 0;
+    }
+
+    (void) memcpy(men, base_men, sizeof(men));
+    twin_castling[0] = '\0';
+    twin_ep[0] = '\0';
+
+    if (base_castling != NULL) {
+        (void) sprintf(twin_castling, "%.4s", base_castling);
+    }
+
+    if (base_ep != NULL) {
+        (void) sprintf(twin_ep, "%.2s", base_ep);
+    }
+
+    for (i = 1; i < t; i++) {
+        s = strchr(s, '/') + 1;
+    }
+
+    for (;;) {
+        size_t len = changeLength(s);
+        rc += applyChange(t, s, len, men);
+        s += len;
+
+        if ((*s == '\0') || (*s == '/')) {
+            break;
+        }
+
+        s++;
+    }
+
+    if (rc == 0) {
+        rc = encode(t, men);
+    }
+
+    if (rc == 0) {
+        opt_kings = twin_kings;
+        opt_gbr = twin_gbr;
+        opt_pos = twin_pos;
+        opt_castling = (twin_castling[0] == '\0') ? NULL : twin_castling;
+        opt_ep = (twin_ep[0] == '\0') ? NULL : twin_ep;
+    }
+
+    return rc;
+}
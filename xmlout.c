@@ -0,0 +1,213 @@
+/*
+ *	xmlout.c
+ *	(c) 2020, Brian Stephenson
+ *	brian@bstephen.me.uk
+ *
+ *	A program to test orthodox chess problems of the types:
+ *
+ *		directmates
+ *		selfmates
+ *		relfexmates
+ *		helpmates
+ *
+ *	Input is taken from the program options and output is xml on stdout.
+ *
+ *	This is the streaming writer for the solution xml. It formats straight
+ *	into one large buffer and writes it out with fwrite when it fills or
+ *	the document ends. Everything it writes is ASCII we generated, so unlike
+ *	genx it does no UTF-8 validation; text is only escaped as genx would.
+ */
+
+#include "sengine.h"
+
+#define XMLOUT_BUFSIZE (1024 * 1024)
+#define XMLOUT_DEPTH 256
+
+static char* buf = NULL;
+static size_t used;
+static FILE* out;
+static const unsigned char* open_el[XMLOUT_DEPTH];
+static int depth;
+static bool tag_open;
+
+static void writeOut(const char* s, size_t n)
+{
+    if ((n > 0) && (fwrite(s, 1, n, out) != n)) {
+        (void) fputs("sengine ERROR: cannot write the xml output\n", stderr);
+        exit(1);
+    }
+
+    return;
+}
+
+static void flushOut(void)
+{
+    writeOut(buf, used);
+    used = 0;
+    return;
+}
+
+static void reserve(size_t n)
+{
+    if ((used + n) > XMLOUT_BUFSIZE) {
+        flushOut();
+    }
+
+    return;
+}
+
+static void putRaw(const char* s)
+{
+    size_t n = strlen(s);
+
+    if (n > XMLOUT_BUFSIZE) {
+        flushOut();
+        writeOut(s, n);
+        return;
+    }
+
+    reserve(n);
+    (void) memcpy(buf + used, s, n);
+    used += n;
+    return;
+}
+
+static void closeTag(void)
+{
+    if (tag_open == true) {
+        reserve(1);
+        buf[used++] = '>';
+        tag_open = false;
+    }
+
+    return;
+}
+
+void xmlStartDoc(FILE* fp)
+{
+    if (buf == NULL) {
+        buf = (char*) malloc(XMLOUT_BUFSIZE);
+        SENGINE_MEM_ASSERT(buf);
+    }
+
+    out = fp;
+    used = 0;
+    depth = 0;
+    tag_open = false;
+    return;
+}
+
+void xmlEndDoc(void)
+{
+    while (depth > 0) {
+        xmlEndElement();
+    }
+
+    flushOut();
+    free(buf);
+    buf = NULL;
+    return;
+}
+
+void xmlStartElement(const unsigned char* name)
+{
+    assert(depth < XMLOUT_DEPTH);
+    closeTag();
+    reserve(1);
+    buf[used++] = '<';
+    putRaw((const char*) name);
+    open_el[depth++] = name;
+    tag_open = true;
+    return;
+}
+
+void xmlAddAttribute(const unsigned char* name, const char* value)
+{
+    const char* p;
+    assert(tag_open == true);
+    reserve(1);
+    buf[used++] = ' ';
+    putRaw((const char*) name);
+    putRaw("=\"");
+
+    for (p = value; *p != '\0'; p++) {
+        switch (*p) {
+        case '"':
+            putRaw("&quot;");
+            break;
+
+        case '<':
+            putRaw("&lt;");
+            break;
+
+        case '&':
+            putRaw("&amp;");
+            break;
+
+        default:
+            reserve(1);
+            buf[used++] = *p;
+            break;
+        }
+    }
+
+    reserve(1);
+    buf[used++] = '"';
+    return;
+}
+
+void xmlAddText(const char* text)
+{
+    const char* p;
+    closeTag();
+
+    for (p = text; *p != '\0'; p++) {
+        switch (*p) {
+        case '<':
+            putRaw("&lt;");
+            break;
+
+        case '>':
+            putRaw("&gt;");
+            break;
+
+        case '&':
+            putRaw("&amp;");
+            break;
+
+        case '\r':
+            putRaw("&#xD;");
+            break;
+
+        default:
+            reserve(1);
+            buf[used++] = *p;
+            break;
+        }
+    }
+
+    return;
+}
+
+void xmlAddMove(BOARD* brd)
+{
+    // Move notation never needs escaping, so it is formatted in place.
+    closeTag();
+    reserve(MOVESTR_LEN);
+    used += strlen(toStr(brd, buf + used));
+    return;
+}
+
+void xmlEndElement(void)
+{
+    assert(depth > 0);
+    depth--;
+    closeTag();
+    reserve(2);
+    buf[used++] = '<';
+    buf[used++] = '/';
+    putRaw((const char*) open_el[depth]);
+    reserve(1);
+    buf[used++] = '>';
+    return;
+}